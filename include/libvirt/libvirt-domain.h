@@ -3266,6 +3266,8 @@ typedef enum {
                                               * completed job */
     VIR_DOMAIN_JOB_STATS_KEEP_COMPLETED = 1 << 1, /* don't remove completed
                                                      stats when reading them */
+    VIR_DOMAIN_JOB_STATS_TELEMETRY = 1 << 2, /* include the history of
+                                              * progress samples */
 } virDomainGetJobStatsFlags;
 
 int virDomainGetJobInfo(virDomainPtr dom,
@@ -3294,6 +3296,22 @@ typedef enum {
 # endif
 } virDomainJobOperation;
 
+/**
+ * virDomainJobAutoSwitchover:
+ *
+ * Action taken by the hypervisor driver's policy to help a migration which
+ * was not converging.
+ */
+typedef enum {
+    VIR_DOMAIN_JOB_AUTO_SWITCHOVER_NONE = 0, /* no action was taken */
+    VIR_DOMAIN_JOB_AUTO_SWITCHOVER_POSTCOPY = 1, /* switched to post-copy */
+    VIR_DOMAIN_JOB_AUTO_SWITCHOVER_THROTTLE = 2, /* raised CPU throttling */
+
+# ifdef VIR_ENUM_SENTINELS
+    VIR_DOMAIN_JOB_AUTO_SWITCHOVER_LAST
+# endif
+} virDomainJobAutoSwitchover;
+
 /**
  * VIR_DOMAIN_JOB_OPERATION:
  *
@@ -3597,6 +3615,33 @@ typedef enum {
  */
 # define VIR_DOMAIN_JOB_AUTO_CONVERGE_THROTTLE  "auto_converge_throttle"
 
+/**
+ * VIR_DOMAIN_JOB_AUTO_SWITCHOVER:
+ *
+ * virDomainGetJobStats field: action taken by the hypervisor to make
+ * a migration converge without client intervention, as VIR_TYPED_PARAM_INT.
+ * The value is one of virDomainJobAutoSwitchover. The field is missing if
+ * no action was taken.
+ */
+# define VIR_DOMAIN_JOB_AUTO_SWITCHOVER "auto_switchover"
+
+/**
+ * VIR_DOMAIN_JOB_AUTO_SWITCHOVER_ITERATION:
+ *
+ * virDomainGetJobStats field: memory iteration in which the action reported
+ * in VIR_DOMAIN_JOB_AUTO_SWITCHOVER was taken, as VIR_TYPED_PARAM_ULLONG.
+ */
+# define VIR_DOMAIN_JOB_AUTO_SWITCHOVER_ITERATION "auto_switchover_iteration"
+
+/**
+ * VIR_DOMAIN_JOB_TUNNEL_BPS:
+ *
+ * virDomainGetJobStats field: average throughput of the tunnel used by
+ * a tunnelled migration in bytes per second, as VIR_TYPED_PARAM_ULLONG.
+ * Only reported for completed migrations.
+ */
+# define VIR_DOMAIN_JOB_TUNNEL_BPS "tunnel_bps"
+
 /**
  * VIR_DOMAIN_JOB_SUCCESS:
  *
@@ -3619,6 +3664,31 @@ typedef enum {
  */
 # define VIR_DOMAIN_JOB_DISK_TEMP_TOTAL "disk_temp_total"
 
+/**
+ * VIR_DOMAIN_JOB_TELEMETRY_COUNT:
+ *
+ * virDomainGetJobStats field: number of progress samples recorded for the
+ * job as VIR_TYPED_PARAM_UINT. Only reported when
+ * VIR_DOMAIN_JOB_STATS_TELEMETRY flag is used and the hypervisor was
+ * configured to record the samples. Each sample is reported as a group of
+ * fields, where <num> goes from 0 (the oldest sample) to
+ * VIR_DOMAIN_JOB_TELEMETRY_COUNT - 1:
+ *
+ * "telemetry.<num>.time" - time in milliseconds since the job started
+ *                          as VIR_TYPED_PARAM_ULLONG
+ * "telemetry.<num>.remaining" - data remaining to be transferred in bytes
+ *                               as VIR_TYPED_PARAM_ULLONG
+ * "telemetry.<num>.dirty_rate" - memory dirty rate in pages per second
+ *                                as VIR_TYPED_PARAM_ULLONG
+ * "telemetry.<num>.bps" - memory transfer throughput in bytes per second
+ *                         as VIR_TYPED_PARAM_ULLONG
+ * "telemetry.<num>.iteration" - number of memory iterations
+ *                               as VIR_TYPED_PARAM_ULLONG
+ * "telemetry.<num>.downtime" - expected downtime in milliseconds
+ *                              as VIR_TYPED_PARAM_ULLONG
+ */
+# define VIR_DOMAIN_JOB_TELEMETRY_COUNT "telemetry.count"
+
 /**
  * virConnectDomainEventGenericCallback:
  * @conn: the connection pointer
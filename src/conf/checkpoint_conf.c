@@ -195,7 +195,7 @@ virDomainCheckpointDefParse(xmlXPathContextPtr ctxt,
     return ret;
 }
 
-static virDomainCheckpointDefPtr
+virDomainCheckpointDefPtr
 virDomainCheckpointDefParseNode(xmlDocPtr xml,
                                 xmlNodePtr root,
                                 virDomainXMLOptionPtr xmlopt,
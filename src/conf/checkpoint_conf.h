@@ -78,6 +78,13 @@ virDomainCheckpointDefParseString(const char *xmlStr,
                                   void *parseOpaque,
                                   unsigned int flags);
 
+virDomainCheckpointDefPtr
+virDomainCheckpointDefParseNode(xmlDocPtr xml,
+                                xmlNodePtr root,
+                                virDomainXMLOptionPtr xmlopt,
+                                void *parseOpaque,
+                                unsigned int flags);
+
 virDomainCheckpointDefPtr
 virDomainCheckpointDefNew(void);
 
@@ -3334,6 +3334,8 @@ void virDomainDefFree(virDomainDefPtr def)
     for (i = 0; i < def->ndisks; i++)
         virDomainDiskDefFree(def->disks[i]);
     VIR_FREE(def->disks);
+    virHashFree(def->diskDstIndex);
+    virHashFree(def->aliasIndex);
 
     for (i = 0; i < def->ncontrollers; i++)
         virDomainControllerDefFree(def->controllers[i]);
@@ -16957,6 +16959,74 @@ virDomainDiskByAddress(virDomainDefPtr def,
     return idx < 0 ? NULL : def->disks[idx];
 }
 
+static void
+virDomainDiskRebuildDstIndex(virDomainDefPtr def)
+{
+    size_t i;
+
+    if (def->diskDstIndex)
+        virHashRemoveAll(def->diskDstIndex);
+    else if (!(def->diskDstIndex = virHashNew(NULL)))
+        goto error;
+
+    for (i = 0; i < def->ndisks; i++) {
+        const char *dst = def->disks[i]->dst;
+
+        /* Keep the first one, as the linear lookup would */
+        if (!dst || virHashLookup(def->diskDstIndex, dst))
+            continue;
+
+        if (virHashAddEntry(def->diskDstIndex, dst, (void *)(i + 1)) < 0)
+            goto error;
+    }
+
+    return;
+
+ error:
+    /* The index is just an optimization */
+    virHashFree(def->diskDstIndex);
+    def->diskDstIndex = NULL;
+    virResetLastError();
+}
+
+
+/**
+ * virDomainDiskIndexByTarget:
+ * @def: domain definition
+ * @dst: target name of the disk
+ *
+ * Looks up the first disk with target @dst. Disks get added, removed and
+ * reordered in many places which don't bother with maintaining an index,
+ * so hits are checked against the disk array and the index is rebuilt
+ * whenever it turned out to be out of date.
+ *
+ * Returns the index of the disk in @def->disks, or -1 if not found.
+ */
+int
+virDomainDiskIndexByTarget(virDomainDefPtr def,
+                           const char *dst)
+{
+    size_t i;
+
+    if (def->diskDstIndex) {
+        size_t idx = (size_t) virHashLookup(def->diskDstIndex, dst);
+
+        if (idx > 0 && idx <= def->ndisks &&
+            STREQ_NULLABLE(def->disks[idx - 1]->dst, dst))
+            return idx - 1;
+    }
+
+    for (i = 0; i < def->ndisks; i++) {
+        if (STREQ_NULLABLE(def->disks[i]->dst, dst)) {
+            virDomainDiskRebuildDstIndex(def);
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+
 int
 virDomainDiskIndexByName(virDomainDefPtr def, const char *name,
                          bool allow_ambiguous)
@@ -16969,12 +17039,12 @@ virDomainDiskIndexByName(virDomainDefPtr def, const char *name,
      * for all disks, and should be unambiguous), but also support
      * <source file='name'/> (if unambiguous).  Assume dst if there is
      * no leading slash, source name otherwise.  */
+    if (*name != '/')
+        return virDomainDiskIndexByTarget(def, name);
+
     for (i = 0; i < def->ndisks; i++) {
         vdisk = def->disks[i];
-        if (*name != '/') {
-            if (STREQ(vdisk->dst, name))
-                return i;
-        } else if (STREQ_NULLABLE(virDomainDiskGetSource(vdisk), name)) {
+        if (STREQ_NULLABLE(virDomainDiskGetSource(vdisk), name)) {
             if (allow_ambiguous)
                 return i;
             if (candidate >= 0)
@@ -16999,14 +17069,8 @@ virDomainDiskDefPtr
 virDomainDiskByTarget(virDomainDefPtr def,
                       const char *dst)
 {
-    size_t i;
-
-    for (i = 0; i < def->ndisks; i++) {
-        if (STREQ(def->disks[i]->dst, dst))
-            return def->disks[i];
-    }
-
-    return NULL;
+    int idx = virDomainDiskIndexByTarget(def, dst);
+    return idx < 0 ? NULL : def->disks[idx];
 }
 
 
@@ -19820,6 +19884,112 @@ virDomainMemorytuneDefParse(virDomainDefPtr def,
 }
 
 
+typedef struct _virDomainDeviceNodeList virDomainDeviceNodeList;
+typedef virDomainDeviceNodeList *virDomainDeviceNodeListPtr;
+struct _virDomainDeviceNodeList {
+    xmlNodePtr *nodes;
+    size_t nnodes;
+};
+
+
+static void
+virDomainDeviceNodeListFree(void *opaque)
+{
+    virDomainDeviceNodeListPtr list = opaque;
+
+    if (!list)
+        return;
+
+    VIR_FREE(list->nodes);
+    VIR_FREE(list);
+}
+
+
+/**
+ * virDomainDefCollectDeviceNodes:
+ * @root: the <domain> element
+ *
+ * Walks the children of <devices> once and groups them by element name,
+ * keeping document order within each group. This replaces evaluating a
+ * separate "./devices/<name>" XPath expression, each scanning all the
+ * devices again, for every device type.
+ *
+ * Returns a hash table of virDomainDeviceNodeList keyed by element name,
+ * or NULL on error.
+ */
+static virHashTablePtr
+virDomainDefCollectDeviceNodes(xmlNodePtr root)
+{
+    g_autoptr(virHashTable) devnodes = NULL;
+    xmlNodePtr devices;
+    xmlNodePtr cur;
+
+    if (!(devnodes = virHashNew(virDomainDeviceNodeListFree)))
+        return NULL;
+
+    for (devices = root->children; devices; devices = devices->next) {
+        /* Unprefixed XPath names match elements without namespace only */
+        if (devices->type != XML_ELEMENT_NODE || devices->ns ||
+            !virXMLNodeNameEqual(devices, "devices"))
+            continue;
+
+        for (cur = devices->children; cur; cur = cur->next) {
+            const char *name = (const char *)cur->name;
+            virDomainDeviceNodeListPtr list;
+
+            if (cur->type != XML_ELEMENT_NODE || cur->ns)
+                continue;
+
+            if (!(list = virHashLookup(devnodes, name))) {
+                list = g_new0(virDomainDeviceNodeList, 1);
+
+                if (virHashAddEntry(devnodes, name, list) < 0) {
+                    virDomainDeviceNodeListFree(list);
+                    return NULL;
+                }
+            }
+
+            if (VIR_APPEND_ELEMENT(list->nodes, list->nnodes, cur) < 0)
+                return NULL;
+        }
+    }
+
+    return g_steal_pointer(&devnodes);
+}
+
+
+/**
+ * virDomainDefStealDeviceNodes:
+ * @devnodes: table filled by virDomainDefCollectDeviceNodes
+ * @name: element name of the devices
+ * @nodes: filled with the list of <@name> device elements
+ *
+ * Hands over the list of <@name> elements found in <devices> to the
+ * caller, who is responsible for freeing @nodes.
+ *
+ * Returns the number of elements in @nodes.
+ */
+static size_t
+virDomainDefStealDeviceNodes(virHashTablePtr devnodes,
+                             const char *name,
+                             xmlNodePtr **nodes)
+{
+    virDomainDeviceNodeListPtr list = virHashSteal(devnodes, name);
+    size_t n;
+
+    *nodes = NULL;
+
+    if (!list)
+        return 0;
+
+    *nodes = g_steal_pointer(&list->nodes);
+    n = list->nnodes;
+    virDomainDeviceNodeListFree(list);
+
+    return n;
+}
+
+
 static virDomainDefPtr
 virDomainDefParseXML(xmlDocPtr xml,
                      xmlXPathContextPtr ctxt,
@@ -19837,6 +20007,7 @@ virDomainDefParseXML(xmlDocPtr xml,
     bool usb_master = false;
     g_autofree xmlNodePtr *nodes = NULL;
     g_autofree char *tmp = NULL;
+    g_autoptr(virHashTable) devnodes = NULL;
 
     if (flags & VIR_DOMAIN_DEF_PARSE_VALIDATE_SCHEMA) {
         g_autofree char *schema = NULL;
@@ -20835,10 +21006,12 @@ virDomainDefParseXML(xmlDocPtr xml,
     if (virDomainDefParseBootOptions(def, ctxt) < 0)
         goto error;
 
-    /* analysis of the disk devices */
-    if ((n = virXPathNodeSet("./devices/disk", ctxt, &nodes)) < 0)
+    if (!(devnodes = virDomainDefCollectDeviceNodes(ctxt->node)))
         goto error;
 
+    /* analysis of the disk devices */
+    n = virDomainDefStealDeviceNodes(devnodes, "disk", &nodes);
+
     if (n && VIR_ALLOC_N(def->disks, n) < 0)
         goto error;
 
@@ -20855,8 +21028,7 @@ virDomainDefParseXML(xmlDocPtr xml,
     VIR_FREE(nodes);
 
     /* analysis of the controller devices */
-    if ((n = virXPathNodeSet("./devices/controller", ctxt, &nodes)) < 0)
-        goto error;
+    n = virDomainDefStealDeviceNodes(devnodes, "controller", &nodes);
 
     if (n && VIR_ALLOC_N(def->controllers, n) < 0)
         goto error;
@@ -20907,11 +21079,7 @@ virDomainDefParseXML(xmlDocPtr xml,
     }
 
     /* analysis of the resource leases */
-    if ((n = virXPathNodeSet("./devices/lease", ctxt, &nodes)) < 0) {
-        virReportError(VIR_ERR_INTERNAL_ERROR,
-                       "%s", _("cannot extract device leases"));
-        goto error;
-    }
+    n = virDomainDefStealDeviceNodes(devnodes, "lease", &nodes);
     if (n && VIR_ALLOC_N(def->leases, n) < 0)
         goto error;
     for (i = 0; i < n; i++) {
@@ -20924,8 +21092,7 @@ virDomainDefParseXML(xmlDocPtr xml,
     VIR_FREE(nodes);
 
     /* analysis of the filesystems */
-    if ((n = virXPathNodeSet("./devices/filesystem", ctxt, &nodes)) < 0)
-        goto error;
+    n = virDomainDefStealDeviceNodes(devnodes, "filesystem", &nodes);
     if (n && VIR_ALLOC_N(def->fss, n) < 0)
         goto error;
     for (i = 0; i < n; i++) {
@@ -20941,8 +21108,7 @@ virDomainDefParseXML(xmlDocPtr xml,
     VIR_FREE(nodes);
 
     /* analysis of the network devices */
-    if ((n = virXPathNodeSet("./devices/interface", ctxt, &nodes)) < 0)
-        goto error;
+    n = virDomainDefStealDeviceNodes(devnodes, "interface", &nodes);
     if (n && VIR_ALLOC_N(def->nets, n) < 0)
         goto error;
     for (i = 0; i < n; i++) {
@@ -20968,8 +21134,7 @@ virDomainDefParseXML(xmlDocPtr xml,
 
 
     /* analysis of the smartcard devices */
-    if ((n = virXPathNodeSet("./devices/smartcard", ctxt, &nodes)) < 0)
-        goto error;
+    n = virDomainDefStealDeviceNodes(devnodes, "smartcard", &nodes);
     if (n && VIR_ALLOC_N(def->smartcards, n) < 0)
         goto error;
 
@@ -20987,8 +21152,7 @@ virDomainDefParseXML(xmlDocPtr xml,
 
 
     /* analysis of the character devices */
-    if ((n = virXPathNodeSet("./devices/parallel", ctxt, &nodes)) < 0)
-        goto error;
+    n = virDomainDefStealDeviceNodes(devnodes, "parallel", &nodes);
     if (n && VIR_ALLOC_N(def->parallels, n) < 0)
         goto error;
 
@@ -21012,8 +21176,7 @@ virDomainDefParseXML(xmlDocPtr xml,
     }
     VIR_FREE(nodes);
 
-    if ((n = virXPathNodeSet("./devices/serial", ctxt, &nodes)) < 0)
-        goto error;
+    n = virDomainDefStealDeviceNodes(devnodes, "serial", &nodes);
 
     if (n && VIR_ALLOC_N(def->serials, n) < 0)
         goto error;
@@ -21038,11 +21201,7 @@ virDomainDefParseXML(xmlDocPtr xml,
     }
     VIR_FREE(nodes);
 
-    if ((n = virXPathNodeSet("./devices/console", ctxt, &nodes)) < 0) {
-        virReportError(VIR_ERR_INTERNAL_ERROR,
-                       "%s", _("cannot extract console devices"));
-        goto error;
-    }
+    n = virDomainDefStealDeviceNodes(devnodes, "console", &nodes);
     if (n && VIR_ALLOC_N(def->consoles, n) < 0)
         goto error;
 
@@ -21059,8 +21218,7 @@ virDomainDefParseXML(xmlDocPtr xml,
     }
     VIR_FREE(nodes);
 
-    if ((n = virXPathNodeSet("./devices/channel", ctxt, &nodes)) < 0)
-        goto error;
+    n = virDomainDefStealDeviceNodes(devnodes, "channel", &nodes);
     if (n && VIR_ALLOC_N(def->channels, n) < 0)
         goto error;
 
@@ -21078,8 +21236,7 @@ virDomainDefParseXML(xmlDocPtr xml,
 
 
     /* analysis of the input devices */
-    if ((n = virXPathNodeSet("./devices/input", ctxt, &nodes)) < 0)
-        goto error;
+    n = virDomainDefStealDeviceNodes(devnodes, "input", &nodes);
     if (n && VIR_ALLOC_N(def->inputs, n) < 0)
         goto error;
 
@@ -21106,8 +21263,7 @@ virDomainDefParseXML(xmlDocPtr xml,
     VIR_FREE(nodes);
 
     /* analysis of the graphics devices */
-    if ((n = virXPathNodeSet("./devices/graphics", ctxt, &nodes)) < 0)
-        goto error;
+    n = virDomainDefStealDeviceNodes(devnodes, "graphics", &nodes);
     if (n && VIR_ALLOC_N(def->graphics, n) < 0)
         goto error;
     for (i = 0; i < n; i++) {
@@ -21123,8 +21279,7 @@ virDomainDefParseXML(xmlDocPtr xml,
     VIR_FREE(nodes);
 
     /* analysis of the sound devices */
-    if ((n = virXPathNodeSet("./devices/sound", ctxt, &nodes)) < 0)
-        goto error;
+    n = virDomainDefStealDeviceNodes(devnodes, "sound", &nodes);
     if (n && VIR_ALLOC_N(def->sounds, n) < 0)
         goto error;
     for (i = 0; i < n; i++) {
@@ -21140,8 +21295,7 @@ virDomainDefParseXML(xmlDocPtr xml,
     VIR_FREE(nodes);
 
     /* analysis of the video devices */
-    if ((n = virXPathNodeSet("./devices/video", ctxt, &nodes)) < 0)
-        goto error;
+    n = virDomainDefStealDeviceNodes(devnodes, "video", &nodes);
     if (n && VIR_ALLOC_N(def->videos, n) < 0)
         goto error;
     for (i = 0; i < n; i++) {
@@ -21174,8 +21328,7 @@ virDomainDefParseXML(xmlDocPtr xml,
     VIR_FREE(nodes);
 
     /* analysis of the host devices */
-    if ((n = virXPathNodeSet("./devices/hostdev", ctxt, &nodes)) < 0)
-        goto error;
+    n = virDomainDefStealDeviceNodes(devnodes, "hostdev", &nodes);
     if (n && VIR_REALLOC_N(def->hostdevs, def->nhostdevs + n) < 0)
         goto error;
     for (i = 0; i < n; i++) {
@@ -21210,8 +21363,7 @@ virDomainDefParseXML(xmlDocPtr xml,
 
     /* analysis of the watchdog devices */
     def->watchdog = NULL;
-    if ((n = virXPathNodeSet("./devices/watchdog", ctxt, &nodes)) < 0)
-        goto error;
+    n = virDomainDefStealDeviceNodes(devnodes, "watchdog", &nodes);
     if (n > 1) {
         virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
                        _("only a single watchdog device is supported"));
@@ -21230,8 +21382,7 @@ virDomainDefParseXML(xmlDocPtr xml,
 
     /* analysis of the memballoon devices */
     def->memballoon = NULL;
-    if ((n = virXPathNodeSet("./devices/memballoon", ctxt, &nodes)) < 0)
-        goto error;
+    n = virDomainDefStealDeviceNodes(devnodes, "memballoon", &nodes);
     if (n > 1) {
         virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
                        _("only a single memory balloon device is supported"));
@@ -21249,8 +21400,7 @@ virDomainDefParseXML(xmlDocPtr xml,
     }
 
     /* Parse the RNG devices */
-    if ((n = virXPathNodeSet("./devices/rng", ctxt, &nodes)) < 0)
-        goto error;
+    n = virDomainDefStealDeviceNodes(devnodes, "rng", &nodes);
     if (n && VIR_ALLOC_N(def->rngs, n) < 0)
         goto error;
     for (i = 0; i < n; i++) {
@@ -21264,8 +21414,7 @@ virDomainDefParseXML(xmlDocPtr xml,
     VIR_FREE(nodes);
 
     /* Parse the TPM devices */
-    if ((n = virXPathNodeSet("./devices/tpm", ctxt, &nodes)) < 0)
-        goto error;
+    n = virDomainDefStealDeviceNodes(devnodes, "tpm", &nodes);
 
     if (n > 1) {
         virReportError(VIR_ERR_XML_ERROR, "%s",
@@ -21279,8 +21428,7 @@ virDomainDefParseXML(xmlDocPtr xml,
     }
     VIR_FREE(nodes);
 
-    if ((n = virXPathNodeSet("./devices/nvram", ctxt, &nodes)) < 0)
-        goto error;
+    n = virDomainDefStealDeviceNodes(devnodes, "nvram", &nodes);
 
     if (n > 1) {
         virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
@@ -21296,8 +21444,7 @@ virDomainDefParseXML(xmlDocPtr xml,
     }
 
     /* analysis of the hub devices */
-    if ((n = virXPathNodeSet("./devices/hub", ctxt, &nodes)) < 0)
-        goto error;
+    n = virDomainDefStealDeviceNodes(devnodes, "hub", &nodes);
     if (n && VIR_ALLOC_N(def->hubs, n) < 0)
         goto error;
     for (i = 0; i < n; i++) {
@@ -21320,8 +21467,7 @@ virDomainDefParseXML(xmlDocPtr xml,
     VIR_FREE(nodes);
 
     /* analysis of the redirected devices */
-    if ((n = virXPathNodeSet("./devices/redirdev", ctxt, &nodes)) < 0)
-        goto error;
+    n = virDomainDefStealDeviceNodes(devnodes, "redirdev", &nodes);
     if (n && VIR_ALLOC_N(def->redirdevs, n) < 0)
         goto error;
     for (i = 0; i < n; i++) {
@@ -21335,8 +21481,7 @@ virDomainDefParseXML(xmlDocPtr xml,
     VIR_FREE(nodes);
 
     /* analysis of the redirection filter rules */
-    if ((n = virXPathNodeSet("./devices/redirfilter", ctxt, &nodes)) < 0)
-        goto error;
+    n = virDomainDefStealDeviceNodes(devnodes, "redirfilter", &nodes);
     if (n > 1) {
         virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
                        _("only one set of redirection filter rule is supported"));
@@ -21354,8 +21499,7 @@ virDomainDefParseXML(xmlDocPtr xml,
     VIR_FREE(nodes);
 
     /* analysis of the panic devices */
-    if ((n = virXPathNodeSet("./devices/panic", ctxt, &nodes)) < 0)
-        goto error;
+    n = virDomainDefStealDeviceNodes(devnodes, "panic", &nodes);
     if (n && VIR_ALLOC_N(def->panics, n) < 0)
         goto error;
     for (i = 0; i < n; i++) {
@@ -21370,8 +21514,7 @@ virDomainDefParseXML(xmlDocPtr xml,
     VIR_FREE(nodes);
 
     /* analysis of the shmem devices */
-    if ((n = virXPathNodeSet("./devices/shmem", ctxt, &nodes)) < 0)
-        goto error;
+    n = virDomainDefStealDeviceNodes(devnodes, "shmem", &nodes);
     if (n && VIR_ALLOC_N(def->shmems, n) < 0)
         goto error;
 
@@ -21396,8 +21539,7 @@ virDomainDefParseXML(xmlDocPtr xml,
     }
 
     /* analysis of memory devices */
-    if ((n = virXPathNodeSet("./devices/memory", ctxt, &nodes)) < 0)
-        goto error;
+    n = virDomainDefStealDeviceNodes(devnodes, "memory", &nodes);
     if (n && VIR_ALLOC_N(def->mems, n) < 0)
         goto error;
 
@@ -21413,8 +21555,7 @@ virDomainDefParseXML(xmlDocPtr xml,
     }
     VIR_FREE(nodes);
 
-    if ((n = virXPathNodeSet("./devices/iommu", ctxt, &nodes)) < 0)
-        goto error;
+    n = virDomainDefStealDeviceNodes(devnodes, "iommu", &nodes);
 
     if (n > 1) {
         virReportError(VIR_ERR_XML_ERROR, "%s",
@@ -21428,8 +21569,7 @@ virDomainDefParseXML(xmlDocPtr xml,
     }
     VIR_FREE(nodes);
 
-    if ((n = virXPathNodeSet("./devices/vsock", ctxt, &nodes)) < 0)
-        goto error;
+    n = virDomainDefStealDeviceNodes(devnodes, "vsock", &nodes);
 
     if (n > 1) {
         virReportError(VIR_ERR_XML_ERROR, "%s",
@@ -30026,6 +30166,208 @@ virDomainChrSourceDefGetSecurityLabelDef(virDomainChrSourceDefPtr def,
 }
 
 
+/* The device arrays of virDomainDef in the order
+ * virDomainDeviceInfoIterateInternal visits them */
+typedef enum {
+    VIR_DOMAIN_DEF_DEVICE_SLOT_DISK,
+    VIR_DOMAIN_DEF_DEVICE_SLOT_NET,
+    VIR_DOMAIN_DEF_DEVICE_SLOT_SOUND,
+    VIR_DOMAIN_DEF_DEVICE_SLOT_HOSTDEV,
+    VIR_DOMAIN_DEF_DEVICE_SLOT_VIDEO,
+    VIR_DOMAIN_DEF_DEVICE_SLOT_CONTROLLER,
+    VIR_DOMAIN_DEF_DEVICE_SLOT_SMARTCARD,
+    VIR_DOMAIN_DEF_DEVICE_SLOT_SERIAL,
+    VIR_DOMAIN_DEF_DEVICE_SLOT_PARALLEL,
+    VIR_DOMAIN_DEF_DEVICE_SLOT_CHANNEL,
+    VIR_DOMAIN_DEF_DEVICE_SLOT_CONSOLE,
+    VIR_DOMAIN_DEF_DEVICE_SLOT_INPUT,
+    VIR_DOMAIN_DEF_DEVICE_SLOT_FS,
+    VIR_DOMAIN_DEF_DEVICE_SLOT_WATCHDOG,
+    VIR_DOMAIN_DEF_DEVICE_SLOT_MEMBALLOON,
+    VIR_DOMAIN_DEF_DEVICE_SLOT_RNG,
+    VIR_DOMAIN_DEF_DEVICE_SLOT_NVRAM,
+    VIR_DOMAIN_DEF_DEVICE_SLOT_HUB,
+    VIR_DOMAIN_DEF_DEVICE_SLOT_SHMEM,
+    VIR_DOMAIN_DEF_DEVICE_SLOT_TPM,
+    VIR_DOMAIN_DEF_DEVICE_SLOT_PANIC,
+    VIR_DOMAIN_DEF_DEVICE_SLOT_MEMORY,
+    VIR_DOMAIN_DEF_DEVICE_SLOT_REDIRDEV,
+    VIR_DOMAIN_DEF_DEVICE_SLOT_VSOCK,
+
+    VIR_DOMAIN_DEF_DEVICE_SLOT_LAST
+} virDomainDefDeviceSlot;
+
+#define VIR_DOMAIN_DEF_DEVICE_AT_ARRAY(devtype, field, array, count) \
+    if (idx >= def->count) \
+        return NULL; \
+    dev->type = devtype; \
+    dev->data.field = def->array[idx]; \
+    return &def->array[idx]->info
+
+#define VIR_DOMAIN_DEF_DEVICE_AT_SINGLE(devtype, field) \
+    if (idx > 0 || !def->field) \
+        return NULL; \
+    dev->type = devtype; \
+    dev->data.field = def->field; \
+    return &def->field->info
+
+/* Fill @dev with the device at @idx of the array @slot of @def.
+ * Returns its info, or NULL if there's no such device. */
+static virDomainDeviceInfoPtr
+virDomainDefDeviceAt(virDomainDefPtr def,
+                     virDomainDefDeviceSlot slot,
+                     size_t idx,
+                     virDomainDeviceDefPtr dev)
+{
+    switch (slot) {
+    case VIR_DOMAIN_DEF_DEVICE_SLOT_DISK:
+        VIR_DOMAIN_DEF_DEVICE_AT_ARRAY(VIR_DOMAIN_DEVICE_DISK,
+                                       disk, disks, ndisks);
+    case VIR_DOMAIN_DEF_DEVICE_SLOT_NET:
+        VIR_DOMAIN_DEF_DEVICE_AT_ARRAY(VIR_DOMAIN_DEVICE_NET,
+                                       net, nets, nnets);
+    case VIR_DOMAIN_DEF_DEVICE_SLOT_SOUND:
+        VIR_DOMAIN_DEF_DEVICE_AT_ARRAY(VIR_DOMAIN_DEVICE_SOUND,
+                                       sound, sounds, nsounds);
+    case VIR_DOMAIN_DEF_DEVICE_SLOT_HOSTDEV:
+        /* the only device whose info isn't embedded */
+        if (idx >= def->nhostdevs)
+            return NULL;
+        dev->type = VIR_DOMAIN_DEVICE_HOSTDEV;
+        dev->data.hostdev = def->hostdevs[idx];
+        return def->hostdevs[idx]->info;
+    case VIR_DOMAIN_DEF_DEVICE_SLOT_VIDEO:
+        VIR_DOMAIN_DEF_DEVICE_AT_ARRAY(VIR_DOMAIN_DEVICE_VIDEO,
+                                       video, videos, nvideos);
+    case VIR_DOMAIN_DEF_DEVICE_SLOT_CONTROLLER:
+        VIR_DOMAIN_DEF_DEVICE_AT_ARRAY(VIR_DOMAIN_DEVICE_CONTROLLER,
+                                       controller, controllers, ncontrollers);
+    case VIR_DOMAIN_DEF_DEVICE_SLOT_SMARTCARD:
+        VIR_DOMAIN_DEF_DEVICE_AT_ARRAY(VIR_DOMAIN_DEVICE_SMARTCARD,
+                                       smartcard, smartcards, nsmartcards);
+    case VIR_DOMAIN_DEF_DEVICE_SLOT_SERIAL:
+        VIR_DOMAIN_DEF_DEVICE_AT_ARRAY(VIR_DOMAIN_DEVICE_CHR,
+                                       chr, serials, nserials);
+    case VIR_DOMAIN_DEF_DEVICE_SLOT_PARALLEL:
+        VIR_DOMAIN_DEF_DEVICE_AT_ARRAY(VIR_DOMAIN_DEVICE_CHR,
+                                       chr, parallels, nparallels);
+    case VIR_DOMAIN_DEF_DEVICE_SLOT_CHANNEL:
+        VIR_DOMAIN_DEF_DEVICE_AT_ARRAY(VIR_DOMAIN_DEVICE_CHR,
+                                       chr, channels, nchannels);
+    case VIR_DOMAIN_DEF_DEVICE_SLOT_CONSOLE:
+        VIR_DOMAIN_DEF_DEVICE_AT_ARRAY(VIR_DOMAIN_DEVICE_CHR,
+                                       chr, consoles, nconsoles);
+    case VIR_DOMAIN_DEF_DEVICE_SLOT_INPUT:
+        VIR_DOMAIN_DEF_DEVICE_AT_ARRAY(VIR_DOMAIN_DEVICE_INPUT,
+                                       input, inputs, ninputs);
+    case VIR_DOMAIN_DEF_DEVICE_SLOT_FS:
+        VIR_DOMAIN_DEF_DEVICE_AT_ARRAY(VIR_DOMAIN_DEVICE_FS,
+                                       fs, fss, nfss);
+    case VIR_DOMAIN_DEF_DEVICE_SLOT_WATCHDOG:
+        VIR_DOMAIN_DEF_DEVICE_AT_SINGLE(VIR_DOMAIN_DEVICE_WATCHDOG, watchdog);
+    case VIR_DOMAIN_DEF_DEVICE_SLOT_MEMBALLOON:
+        VIR_DOMAIN_DEF_DEVICE_AT_SINGLE(VIR_DOMAIN_DEVICE_MEMBALLOON, memballoon);
+    case VIR_DOMAIN_DEF_DEVICE_SLOT_RNG:
+        VIR_DOMAIN_DEF_DEVICE_AT_ARRAY(VIR_DOMAIN_DEVICE_RNG,
+                                       rng, rngs, nrngs);
+    case VIR_DOMAIN_DEF_DEVICE_SLOT_NVRAM:
+        VIR_DOMAIN_DEF_DEVICE_AT_SINGLE(VIR_DOMAIN_DEVICE_NVRAM, nvram);
+    case VIR_DOMAIN_DEF_DEVICE_SLOT_HUB:
+        VIR_DOMAIN_DEF_DEVICE_AT_ARRAY(VIR_DOMAIN_DEVICE_HUB,
+                                       hub, hubs, nhubs);
+    case VIR_DOMAIN_DEF_DEVICE_SLOT_SHMEM:
+        VIR_DOMAIN_DEF_DEVICE_AT_ARRAY(VIR_DOMAIN_DEVICE_SHMEM,
+                                       shmem, shmems, nshmems);
+    case VIR_DOMAIN_DEF_DEVICE_SLOT_TPM:
+        VIR_DOMAIN_DEF_DEVICE_AT_SINGLE(VIR_DOMAIN_DEVICE_TPM, tpm);
+    case VIR_DOMAIN_DEF_DEVICE_SLOT_PANIC:
+        VIR_DOMAIN_DEF_DEVICE_AT_ARRAY(VIR_DOMAIN_DEVICE_PANIC,
+                                       panic, panics, npanics);
+    case VIR_DOMAIN_DEF_DEVICE_SLOT_MEMORY:
+        VIR_DOMAIN_DEF_DEVICE_AT_ARRAY(VIR_DOMAIN_DEVICE_MEMORY,
+                                       memory, mems, nmems);
+    case VIR_DOMAIN_DEF_DEVICE_SLOT_REDIRDEV:
+        VIR_DOMAIN_DEF_DEVICE_AT_ARRAY(VIR_DOMAIN_DEVICE_REDIRDEV,
+                                       redirdev, redirdevs, nredirdevs);
+    case VIR_DOMAIN_DEF_DEVICE_SLOT_VSOCK:
+        VIR_DOMAIN_DEF_DEVICE_AT_SINGLE(VIR_DOMAIN_DEVICE_VSOCK, vsock);
+    case VIR_DOMAIN_DEF_DEVICE_SLOT_LAST:
+        break;
+    }
+
+    return NULL;
+}
+
+#undef VIR_DOMAIN_DEF_DEVICE_AT_ARRAY
+#undef VIR_DOMAIN_DEF_DEVICE_AT_SINGLE
+
+
+/* Index entries encode the slot and the position in its array, offset
+ * by one so that they are never NULL */
+#define VIR_DOMAIN_DEF_ALIAS_INDEX_ENTRY(slot, idx) \
+    ((void *)(((idx) * VIR_DOMAIN_DEF_DEVICE_SLOT_LAST + (slot)) + 1))
+
+static void
+virDomainDefRebuildAliasIndex(virDomainDefPtr def)
+{
+    virDomainDeviceDef dev;
+    virDomainDeviceInfoPtr info;
+    size_t slot;
+    size_t i;
+
+    if (def->aliasIndex)
+        virHashRemoveAll(def->aliasIndex);
+    else if (!(def->aliasIndex = virHashNew(NULL)))
+        goto error;
+
+    for (slot = 0; slot < VIR_DOMAIN_DEF_DEVICE_SLOT_LAST; slot++) {
+        for (i = 0; (info = virDomainDefDeviceAt(def, slot, i, &dev)); i++) {
+            /* Keep the first one, as the linear lookup would */
+            if (!info->alias || virHashLookup(def->aliasIndex, info->alias))
+                continue;
+
+            if (virHashAddEntry(def->aliasIndex, info->alias,
+                                VIR_DOMAIN_DEF_ALIAS_INDEX_ENTRY(slot, i)) < 0)
+                goto error;
+        }
+    }
+
+    return;
+
+ error:
+    /* The index is just an optimization */
+    virHashFree(def->aliasIndex);
+    def->aliasIndex = NULL;
+    virResetLastError();
+}
+
+
+/* Look @devAlias up in the alias index of @def. Like the index of disk
+ * targets it may be out of date, so a hit is only used if the device it
+ * points to still has that alias. */
+static bool
+virDomainDefFindDeviceIndexed(virDomainDefPtr def,
+                              const char *devAlias,
+                              virDomainDeviceDefPtr dev)
+{
+    virDomainDeviceInfoPtr info;
+    size_t entry;
+
+    if (!def->aliasIndex ||
+        !(entry = (size_t) virHashLookup(def->aliasIndex, devAlias)))
+        return false;
+
+    entry--;
+    if (!(info = virDomainDefDeviceAt(def,
+                                      entry % VIR_DOMAIN_DEF_DEVICE_SLOT_LAST,
+                                      entry / VIR_DOMAIN_DEF_DEVICE_SLOT_LAST,
+                                      dev)))
+        return false;
+
+    return STREQ_NULLABLE(info->alias, devAlias);
+}
+
+
 typedef struct {
     const char *devAlias;
     virDomainDeviceDefPtr dev;
@@ -30054,6 +30396,9 @@ virDomainDefFindDevice(virDomainDefPtr def,
 {
     virDomainDefFindDeviceCallbackData data = { devAlias, dev };
 
+    if (virDomainDefFindDeviceIndexed(def, devAlias, dev))
+        return 0;
+
     dev->type = VIR_DOMAIN_DEVICE_NONE;
     virDomainDeviceInfoIterateInternal(def, virDomainDefFindDeviceCallback,
                                        DOMAIN_DEVICE_ITERATE_ALL_CONSOLES,
@@ -30069,6 +30414,8 @@ virDomainDefFindDevice(virDomainDefPtr def,
         return -1;
     }
 
+    /* the index was missing or out of date */
+    virDomainDefRebuildAliasIndex(def);
     return 0;
 }
 
@@ -2446,6 +2446,11 @@ struct _virDomainDef {
 
     size_t ndisks;
     virDomainDiskDefPtr *disks;
+    /* Lazily built lookup of disks by target name, see
+     * virDomainDiskIndexByTarget. Entries may be stale. */
+    virHashTablePtr diskDstIndex;
+    /* Likewise for devices by alias, see virDomainDefFindDevice */
+    virHashTablePtr aliasIndex;
 
     size_t ncontrollers;
     virDomainControllerDefPtr *controllers;
@@ -3157,6 +3162,8 @@ virDomainDiskDefPtr virDomainDiskByAddress(virDomainDefPtr def,
                                            unsigned int unit);
 int virDomainDiskIndexByName(virDomainDefPtr def, const char *name,
                              bool allow_ambiguous);
+int virDomainDiskIndexByTarget(virDomainDefPtr def,
+                               const char *dst);
 virDomainDiskDefPtr virDomainDiskByName(virDomainDefPtr def,
                                         const char *name,
                                         bool allow_ambiguous);
@@ -218,6 +218,9 @@ virDomainSnapshotDiskDefParseXML(xmlNodePtr node,
 /* flags is bitwise-or of virDomainSnapshotParseFlags.
  * If flags does not include
  * VIR_DOMAIN_SNAPSHOT_PARSE_INTERNAL, then current is ignored.
+ * With VIR_DOMAIN_SNAPSHOT_PARSE_DEFER_DOMAIN, <domain> and
+ * <inactiveDomain> are not parsed; domainDeferred records whether they
+ * are present so that the caller can parse them later.
  */
 static virDomainSnapshotDefPtr
 virDomainSnapshotDefParse(xmlXPathContextPtr ctxt,
@@ -289,7 +292,11 @@ virDomainSnapshotDefParse(xmlXPathContextPtr ctxt,
          * lack domain/@type.  In that case, leave dom NULL, and
          * clients will have to decide between best effort
          * initialization or outright failure.  */
-        if ((tmp = virXPathString("string(./domain/@type)", ctxt))) {
+        if ((flags & VIR_DOMAIN_SNAPSHOT_PARSE_DEFER_DOMAIN) &&
+            (virXPathBoolean("boolean(./domain/@type)", ctxt) == 1 ||
+             virXPathNode("./inactiveDomain", ctxt))) {
+            def->domainDeferred = true;
+        } else if ((tmp = virXPathString("string(./domain/@type)", ctxt))) {
             xmlNodePtr domainNode = virXPathNode("./domain", ctxt);
 
             VIR_FREE(tmp);
@@ -310,7 +317,8 @@ virDomainSnapshotDefParse(xmlXPathContextPtr ctxt,
         /* /inactiveDomain entry saves the config XML present in a running
          * VM. In case of absent, leave parent.inactiveDom NULL and use
          * parent.dom for config and live XML. */
-        if ((inactiveDomNode = virXPathNode("./inactiveDomain", ctxt))) {
+        if (!def->domainDeferred &&
+            (inactiveDomNode = virXPathNode("./inactiveDomain", ctxt))) {
             def->parent.inactiveDom = virDomainDefParseNode(ctxt->node->doc, inactiveDomNode,
                                                             xmlopt, NULL, domainflags);
             if (!def->parent.inactiveDom)
@@ -843,6 +851,13 @@ virDomainSnapshotDefFormatInternal(virBufferPtr buf,
     if (flags & VIR_DOMAIN_SNAPSHOT_FORMAT_SECURE)
         domainflags |= VIR_DOMAIN_DEF_FORMAT_SECURE;
 
+    if (def->domainDeferred) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("domain definition of snapshot '%s' is not loaded"),
+                       def->parent.name);
+        return -1;
+    }
+
     virBufferAddLit(buf, "<domainsnapshot>\n");
     virBufferAdjustIndent(buf, 2);
 
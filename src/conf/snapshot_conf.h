@@ -85,6 +85,10 @@ struct _virDomainSnapshotDef {
     virDomainSnapshotDiskDef *disks;
 
     virObjectPtr cookie;
+
+    /* The XML this was parsed from has <domain> or <inactiveDomain>,
+     * but parent.dom and parent.inactiveDom were not parsed yet. */
+    bool domainDeferred;
 };
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(virDomainSnapshotDef, virObjectUnref);
@@ -96,6 +100,7 @@ typedef enum {
     VIR_DOMAIN_SNAPSHOT_PARSE_INTERNAL = 1 << 2,
     VIR_DOMAIN_SNAPSHOT_PARSE_OFFLINE  = 1 << 3,
     VIR_DOMAIN_SNAPSHOT_PARSE_VALIDATE = 1 << 4,
+    VIR_DOMAIN_SNAPSHOT_PARSE_DEFER_DOMAIN = 1 << 5,
 } virDomainSnapshotParseFlags;
 
 typedef enum {
@@ -801,24 +801,45 @@ virStoragePoolDefRefreshParse(xmlXPathContextPtr ctxt,
 {
     g_autofree virStoragePoolDefRefreshPtr refresh = NULL;
     g_autofree char *allocation = NULL;
+    unsigned int threads = 0;
     int tmp;
 
     allocation = virXPathString("string(./refresh/volume/@allocation)", ctxt);
 
-    if (!allocation)
-        return 0;
+    if ((tmp = virXPathUInt("string(./refresh/probe/@threads)",
+                            ctxt, &threads)) == -2 ||
+        (tmp == 0 && threads == 0)) {
+        virReportError(VIR_ERR_XML_ERROR, "%s",
+                       _("storage pool probe threads must be a positive integer"));
+        return -1;
+    }
 
-    if ((tmp = virStorageVolDefRefreshAllocationTypeFromString(allocation)) < 0) {
+    if (threads > VIR_STORAGE_POOL_REFRESH_PROBE_THREADS_MAX) {
         virReportError(VIR_ERR_CONFIG_UNSUPPORTED,
-                       _("unknown storage pool volume refresh allocation type %s"),
-                       allocation);
+                       _("storage pool probe threads %u exceed the maximum of %u"),
+                       threads, VIR_STORAGE_POOL_REFRESH_PROBE_THREADS_MAX);
         return -1;
     }
 
+    if (!allocation && threads == 0)
+        return 0;
+
     if (VIR_ALLOC(refresh) < 0)
         return -1;
 
-    refresh->volume.allocation = tmp;
+    if (allocation) {
+        if ((tmp = virStorageVolDefRefreshAllocationTypeFromString(allocation)) < 0) {
+            virReportError(VIR_ERR_CONFIG_UNSUPPORTED,
+                           _("unknown storage pool volume refresh allocation type %s"),
+                           allocation);
+            return -1;
+        }
+
+        refresh->has_volume = true;
+        refresh->volume.allocation = tmp;
+    }
+
+    refresh->probe.threads = threads;
     def->refresh = g_steal_pointer(&refresh);
     return 0;
 }
@@ -833,8 +854,11 @@ virStoragePoolDefRefreshFormat(virBufferPtr buf,
 
     virBufferAddLit(buf, "<refresh>\n");
     virBufferAdjustIndent(buf, 2);
-    virBufferAsprintf(buf, "<volume allocation='%s'/>\n",
-                      virStorageVolDefRefreshAllocationTypeToString(refresh->volume.allocation));
+    if (refresh->has_volume)
+        virBufferAsprintf(buf, "<volume allocation='%s'/>\n",
+                          virStorageVolDefRefreshAllocationTypeToString(refresh->volume.allocation));
+    if (refresh->probe.threads)
+        virBufferAsprintf(buf, "<probe threads='%u'/>\n", refresh->probe.threads);
     virBufferAdjustIndent(buf, -2);
     virBufferAddLit(buf, "</refresh>\n");
 }
@@ -1256,6 +1280,75 @@ virStorageSize(const char *unit,
 }
 
 
+static int
+virStorageVolTimestampParse(xmlXPathContextPtr ctxt,
+                            const char *xpath,
+                            struct timespec *ts)
+{
+    g_autofree char *str = NULL;
+    unsigned long long sec;
+    long nsec = 0;
+    char *end;
+
+    ts->tv_sec = 0;
+    ts->tv_nsec = -1;
+
+    if (!(str = virXPathString(xpath, ctxt)))
+        return 0;
+
+    if (virStrToLong_ull(str, &end, 10, &sec) < 0 ||
+        (*end && (*end != '.' ||
+                  virStrToLong_l(end + 1, NULL, 10, &nsec) < 0 ||
+                  nsec < 0 || nsec > 999999999))) {
+        virReportError(VIR_ERR_XML_ERROR,
+                       _("invalid volume timestamp '%s'"), str);
+        return -1;
+    }
+
+    ts->tv_sec = sec;
+    ts->tv_nsec = nsec;
+    return 0;
+}
+
+
+static int
+virStorageVolDefParseStatus(xmlXPathContextPtr ctxt,
+                            virStorageVolDefPtr def)
+{
+    g_autofree char *physical = NULL;
+    g_autofree char *unit = NULL;
+    virStorageTimestampsPtr timestamps;
+
+    /* allocation of probed volumes is never user specified */
+    def->target.has_allocation = false;
+
+    if ((physical = virXPathString("string(./physical)", ctxt))) {
+        unit = virXPathString("string(./physical/@unit)", ctxt);
+        if (virStorageSize(unit, physical, &def->target.physical) < 0)
+            return -1;
+    }
+
+    if (!virXPathNode("./target/timestamps", ctxt))
+        return 0;
+
+    if (VIR_ALLOC(timestamps) < 0)
+        return -1;
+    def->target.timestamps = timestamps;
+
+    if (virStorageVolTimestampParse(ctxt, "string(./target/timestamps/atime)",
+                                    &timestamps->atime) < 0 ||
+        virStorageVolTimestampParse(ctxt, "string(./target/timestamps/mtime)",
+                                    &timestamps->mtime) < 0 ||
+        virStorageVolTimestampParse(ctxt, "string(./target/timestamps/ctime)",
+                                    &timestamps->ctime) < 0 ||
+        virStorageVolTimestampParse(ctxt, "string(./target/timestamps/btime)",
+                                    &timestamps->btime) < 0)
+        return -1;
+
+    return 0;
+}
+
+
 static virStorageVolDefPtr
 virStorageVolDefParseXML(virStoragePoolDefPtr pool,
                          xmlXPathContextPtr ctxt,
@@ -1274,7 +1367,8 @@ virStorageVolDefParseXML(virStoragePoolDefPtr pool,
     g_autofree xmlNodePtr *nodes = NULL;
 
     virCheckFlags(VIR_VOL_XML_PARSE_NO_CAPACITY |
-                  VIR_VOL_XML_PARSE_OPT_CAPACITY, NULL);
+                  VIR_VOL_XML_PARSE_OPT_CAPACITY |
+                  VIR_VOL_XML_PARSE_STATUS, NULL);
 
     options = virStorageVolOptionsForPoolType(pool->type);
     if (options == NULL)
@@ -1420,6 +1514,10 @@ virStorageVolDefParseXML(virStoragePoolDefPtr pool,
         VIR_FREE(nodes);
     }
 
+    if (flags & VIR_VOL_XML_PARSE_STATUS &&
+        virStorageVolDefParseStatus(ctxt, def) < 0)
+        return NULL;
+
     return g_steal_pointer(&def);
 }
 
@@ -76,6 +76,19 @@ typedef enum {
 
 VIR_ENUM_DECL(virStorageVolDefRefreshAllocation);
 
+/* Identity of the file a volume's target was probed from. Backends
+ * which enumerate files use it to find volumes which did not change
+ * since the last refresh and do not need to be probed again. */
+typedef struct _virStorageVolProbeStamp virStorageVolProbeStamp;
+typedef virStorageVolProbeStamp *virStorageVolProbeStampPtr;
+struct _virStorageVolProbeStamp {
+    unsigned long long dev;
+    unsigned long long ino;
+    unsigned long long size;
+    long long mtime; /* nanoseconds since epoch */
+    long long ctime; /* nanoseconds since epoch */
+};
+
 typedef struct _virStorageVolDef virStorageVolDef;
 typedef virStorageVolDef *virStorageVolDefPtr;
 struct _virStorageVolDef {
@@ -86,6 +99,8 @@ struct _virStorageVolDef {
     bool building;
     unsigned int in_use;
 
+    virStorageVolProbeStamp stamp; /* all zero if never probed */
+
     virStorageVolSource source;
     virStorageSource target;
 };
@@ -236,10 +251,22 @@ struct _virStorageVolDefRefresh {
 };
 
 
+typedef struct _virStoragePoolDefRefreshProbe virStoragePoolDefRefreshProbe;
+typedef virStoragePoolDefRefreshProbe *virStoragePoolDefRefreshProbePtr;
+struct _virStoragePoolDefRefreshProbe {
+  unsigned int threads; /* 0 if not set */
+};
+
+/* Upper limit of <refresh><probe threads='N'/> */
+#define VIR_STORAGE_POOL_REFRESH_PROBE_THREADS_MAX 64
+
+
 typedef struct _virStoragePoolDefRefresh virStoragePoolDefRefresh;
 typedef virStoragePoolDefRefresh *virStoragePoolDefRefreshPtr;
 struct _virStoragePoolDefRefresh {
+  bool has_volume; /* Set to true when <volume> is provided in XML */
   virStorageVolDefRefresh volume;
+  virStoragePoolDefRefreshProbe probe;
 };
 
 
@@ -293,6 +320,9 @@ typedef enum {
     VIR_VOL_XML_PARSE_NO_CAPACITY  = 1 << 0,
     /* do not require volume capacity if the volume has a backing store */
     VIR_VOL_XML_PARSE_OPT_CAPACITY = 1 << 1,
+    /* parse runtime data which is normally only reported, such as
+     * physical size and timestamps, e.g. when restoring cached volumes */
+    VIR_VOL_XML_PARSE_STATUS       = 1 << 2,
 } virStorageVolDefParseFlags;
 
 virStorageVolDefPtr
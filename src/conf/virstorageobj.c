@@ -106,6 +106,13 @@ struct _virStoragePoolObjList {
     /* name string -> virStoragePoolObj mapping
      * for (1), lockless lookup-by-name */
     virHashTable *objsName;
+
+    /* volume key / volume path string -> pool UUID mapping
+     * remembering which pool a volume was last found in; entries
+     * may be stale and are verified on use */
+    virMutex volHintsLock; /* leaf lock, protects the tables below */
+    bool volHintsLockInit;
+    virHashTable *volHints[VIR_STORAGE_POOL_OBJ_VOL_HINT_LAST];
 };
 
 
@@ -387,9 +394,14 @@ void
 virStoragePoolObjListDispose(void *opaque)
 {
     virStoragePoolObjListPtr pools = opaque;
+    size_t i;
 
     virHashFree(pools->objs);
     virHashFree(pools->objsName);
+    for (i = 0; i < VIR_STORAGE_POOL_OBJ_VOL_HINT_LAST; i++)
+        virHashFree(pools->volHints[i]);
+    if (pools->volHintsLockInit)
+        virMutexDestroy(&pools->volHintsLock);
 }
 
 
@@ -397,6 +409,7 @@ virStoragePoolObjListPtr
 virStoragePoolObjListNew(void)
 {
     virStoragePoolObjListPtr pools;
+    size_t i;
 
     if (virStoragePoolObjInitialize() < 0)
         return NULL;
@@ -404,12 +417,27 @@ virStoragePoolObjListNew(void)
     if (!(pools = virObjectRWLockableNew(virStoragePoolObjListClass)))
         return NULL;
 
+    if (virMutexInit(&pools->volHintsLock) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("cannot initialize mutex"));
+        virObjectUnref(pools);
+        return NULL;
+    }
+    pools->volHintsLockInit = true;
+
     if (!(pools->objs = virHashCreate(20, virObjectFreeHashData)) ||
         !(pools->objsName = virHashCreate(20, virObjectFreeHashData))) {
         virObjectUnref(pools);
         return NULL;
     }
 
+    for (i = 0; i < VIR_STORAGE_POOL_OBJ_VOL_HINT_LAST; i++) {
+        if (!(pools->volHints[i] = virHashNew(virHashValueFree))) {
+            virObjectUnref(pools);
+            return NULL;
+        }
+    }
+
     return pools;
 }
 
@@ -521,6 +549,159 @@ virStoragePoolObjListSearch(virStoragePoolObjListPtr pools,
 }
 
 
+static void
+virStoragePoolObjListSetVolHint(virStoragePoolObjListPtr pools,
+                                virStoragePoolObjVolHint hint,
+                                const char *name,
+                                const unsigned char *uuid)
+{
+    unsigned char *copy = g_new0(unsigned char, VIR_UUID_BUFLEN);
+
+    memcpy(copy, uuid, VIR_UUID_BUFLEN);
+
+    virMutexLock(&pools->volHintsLock);
+    if (virHashUpdateEntry(pools->volHints[hint], name, copy) < 0)
+        VIR_FREE(copy);
+    virMutexUnlock(&pools->volHintsLock);
+}
+
+
+/**
+ * virStoragePoolObjListSearchVol:
+ * @pools: Pointer to pools object
+ * @hint: which kind of volume identifier @name is
+ * @name: volume key or path being looked up
+ * @searcher: Callback searcher helper
+ * @opaque: Opaque data to use as argument to helper
+ *
+ * Like virStoragePoolObjListSearch, but meant for looking up a volume by
+ * its key or path. The pool the volume was found in last time is tried
+ * first, so that repeated lookups of the same volume do not need to lock
+ * and search every pool. If the volume is not there anymore, all pools
+ * are searched and the result is remembered for next time.
+ *
+ * Returns a locked and reffed object when found and NULL when not found
+ */
+virStoragePoolObjPtr
+virStoragePoolObjListSearchVol(virStoragePoolObjListPtr pools,
+                               virStoragePoolObjVolHint hint,
+                               const char *name,
+                               virStoragePoolObjListSearcher searcher,
+                               const void *opaque)
+{
+    virStoragePoolObjPtr obj = NULL;
+    unsigned char uuid[VIR_UUID_BUFLEN];
+    unsigned char *hintuuid;
+    bool haveHint = false;
+
+    virMutexLock(&pools->volHintsLock);
+    if ((hintuuid = virHashLookup(pools->volHints[hint], name))) {
+        memcpy(uuid, hintuuid, VIR_UUID_BUFLEN);
+        haveHint = true;
+    }
+    virMutexUnlock(&pools->volHintsLock);
+
+    if (haveHint &&
+        (obj = virStoragePoolObjFindByUUID(pools, uuid))) {
+        if (searcher(obj, opaque))
+            return obj;
+        virStoragePoolObjEndAPI(&obj);
+    }
+
+    if (!(obj = virStoragePoolObjListSearch(pools, searcher, opaque))) {
+        if (haveHint)
+            virStoragePoolObjListForgetVolHint(pools, hint, name);
+        return NULL;
+    }
+
+    virStoragePoolObjListSetVolHint(pools, hint, name, obj->def->uuid);
+    return obj;
+}
+
+
+/**
+ * virStoragePoolObjListRememberVol:
+ * @pools: Pointer to pools object
+ * @obj: pool object @voldef belongs to
+ * @voldef: volume definition
+ *
+ * Remember that @voldef can be found by its key and path in @obj.
+ */
+void
+virStoragePoolObjListRememberVol(virStoragePoolObjListPtr pools,
+                                 virStoragePoolObjPtr obj,
+                                 virStorageVolDefPtr voldef)
+{
+    virStoragePoolObjListSetVolHint(pools, VIR_STORAGE_POOL_OBJ_VOL_HINT_KEY,
+                                    voldef->key, obj->def->uuid);
+    virStoragePoolObjListSetVolHint(pools, VIR_STORAGE_POOL_OBJ_VOL_HINT_PATH,
+                                    voldef->target.path, obj->def->uuid);
+}
+
+
+void
+virStoragePoolObjListForgetVolHint(virStoragePoolObjListPtr pools,
+                                   virStoragePoolObjVolHint hint,
+                                   const char *name)
+{
+    virMutexLock(&pools->volHintsLock);
+    virHashRemoveEntry(pools->volHints[hint], name);
+    virMutexUnlock(&pools->volHintsLock);
+}
+
+
+/**
+ * virStoragePoolObjListForgetVol:
+ * @pools: Pointer to pools object
+ * @voldef: volume definition
+ *
+ * Drop what was remembered about where @voldef can be found by its key
+ * and path, e.g. because the volume is being deleted.
+ */
+void
+virStoragePoolObjListForgetVol(virStoragePoolObjListPtr pools,
+                               virStorageVolDefPtr voldef)
+{
+    virStoragePoolObjListForgetVolHint(pools, VIR_STORAGE_POOL_OBJ_VOL_HINT_KEY,
+                                       voldef->key);
+    virStoragePoolObjListForgetVolHint(pools, VIR_STORAGE_POOL_OBJ_VOL_HINT_PATH,
+                                       voldef->target.path);
+}
+
+
+static int
+virStoragePoolObjListVolHintMatch(const void *payload,
+                                  const void *name G_GNUC_UNUSED,
+                                  const void *opaque)
+{
+    return memcmp(payload, opaque, VIR_UUID_BUFLEN) == 0;
+}
+
+
+/**
+ * virStoragePoolObjListForgetPoolVols:
+ * @pools: Pointer to pools object
+ * @obj: pool object
+ *
+ * Drop what was remembered about volumes being found in @obj, e.g.
+ * because its volumes are being dropped or re-read, or the pool itself
+ * is removed.
+ */
+void
+virStoragePoolObjListForgetPoolVols(virStoragePoolObjListPtr pools,
+                                    virStoragePoolObjPtr obj)
+{
+    size_t i;
+
+    virMutexLock(&pools->volHintsLock);
+    for (i = 0; i < VIR_STORAGE_POOL_OBJ_VOL_HINT_LAST; i++)
+        virHashRemoveSet(pools->volHints[i],
+                         virStoragePoolObjListVolHintMatch,
+                         obj->def->uuid);
+    virMutexUnlock(&pools->volHintsLock);
+}
+
+
 void
 virStoragePoolObjRemove(virStoragePoolObjListPtr pools,
                         virStoragePoolObjPtr obj)
@@ -534,6 +715,7 @@ virStoragePoolObjRemove(virStoragePoolObjListPtr pools,
     virObjectLock(obj);
     virHashRemoveEntry(pools->objs, uuidstr);
     virHashRemoveEntry(pools->objsName, obj->def->name);
+    virStoragePoolObjListForgetPoolVols(pools, obj);
     virObjectUnref(obj);
     virObjectRWUnlock(pools);
 }
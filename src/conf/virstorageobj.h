@@ -256,6 +256,38 @@ virStoragePoolObjListSearch(virStoragePoolObjListPtr pools,
                             virStoragePoolObjListSearcher searcher,
                             const void *opaque);
 
+typedef enum {
+    VIR_STORAGE_POOL_OBJ_VOL_HINT_KEY,
+    VIR_STORAGE_POOL_OBJ_VOL_HINT_PATH,
+
+    VIR_STORAGE_POOL_OBJ_VOL_HINT_LAST
+} virStoragePoolObjVolHint;
+
+virStoragePoolObjPtr
+virStoragePoolObjListSearchVol(virStoragePoolObjListPtr pools,
+                               virStoragePoolObjVolHint hint,
+                               const char *name,
+                               virStoragePoolObjListSearcher searcher,
+                               const void *opaque);
+
+void
+virStoragePoolObjListRememberVol(virStoragePoolObjListPtr pools,
+                                 virStoragePoolObjPtr obj,
+                                 virStorageVolDefPtr voldef);
+
+void
+virStoragePoolObjListForgetVolHint(virStoragePoolObjListPtr pools,
+                                   virStoragePoolObjVolHint hint,
+                                   const char *name);
+
+void
+virStoragePoolObjListForgetVol(virStoragePoolObjListPtr pools,
+                               virStorageVolDefPtr voldef);
+
+void
+virStoragePoolObjListForgetPoolVols(virStoragePoolObjListPtr pools,
+                                    virStoragePoolObjPtr obj);
+
 virStoragePoolObjListPtr
 virStoragePoolObjListNew(void);
 
@@ -8804,6 +8804,12 @@ virDomainGetJobInfo(virDomainPtr domain, virDomainJobInfoPtr info)
  * obtained by listening to a VIR_DOMAIN_EVENT_ID_JOB_COMPLETED event (on the
  * source host in case of a migration job).
  *
+ * When @flags contains VIR_DOMAIN_JOB_STATS_TELEMETRY, the returned
+ * statistics will also contain the history of progress samples recorded
+ * while the job was running (see VIR_DOMAIN_JOB_TELEMETRY_COUNT). The
+ * history is only recorded if the hypervisor driver was configured to do
+ * so and it is kept until another job is started.
+ *
  * Returns 0 in case of success and -1 in case of failure.
  */
 int
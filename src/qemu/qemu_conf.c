@@ -70,6 +70,13 @@ VIR_LOG_INIT("qemu.qemu_conf");
 #define QEMU_MIGRATION_PORT_MIN 49152
 #define QEMU_MIGRATION_PORT_MAX 49215
 
+/* Each sample takes 6 job stats fields, which all have to fit into
+ * REMOTE_DOMAIN_GET_JOB_STATS_MAX */
+#define QEMU_MIGRATION_TELEMETRY_SAMPLES_MAX 170
+#define QEMU_MIGRATION_TELEMETRY_INTERVAL 500
+
+#define QEMU_MIGRATION_AUTO_SWITCHOVER_ITERATIONS 2
+
 static virClassPtr virQEMUDriverConfigClass;
 static void virQEMUDriverConfigDispose(void *obj);
 
@@ -215,6 +222,9 @@ virQEMUDriverConfigPtr virQEMUDriverConfigNew(bool privileged)
     cfg->migrationPortMin = QEMU_MIGRATION_PORT_MIN;
     cfg->migrationPortMax = QEMU_MIGRATION_PORT_MAX;
 
+    cfg->migrationTelemetryInterval = QEMU_MIGRATION_TELEMETRY_INTERVAL;
+    cfg->migrationAutoSwitchoverIterations = QEMU_MIGRATION_AUTO_SWITCHOVER_ITERATIONS;
+
     /* For privileged driver, try and find hugetlbfs mounts automatically.
      * Non-privileged driver requires admin to create a dir for the
      * user, chown it, and then let user configure it manually. */
@@ -741,6 +751,50 @@ virQEMUDriverConfigLoadNetworkEntry(virQEMUDriverConfigPtr cfg,
         return -1;
     }
 
+    if (virConfGetValueUInt(conf, "migration_telemetry_samples",
+                            &cfg->migrationTelemetrySamples) < 0)
+        return -1;
+    if (cfg->migrationTelemetrySamples > QEMU_MIGRATION_TELEMETRY_SAMPLES_MAX) {
+        virReportError(VIR_ERR_CONF_SYNTAX,
+                       _("%s: migration_telemetry_samples must not be greater "
+                         "than %d"),
+                       filename, QEMU_MIGRATION_TELEMETRY_SAMPLES_MAX);
+        return -1;
+    }
+
+    if (virConfGetValueUInt(conf, "migration_telemetry_interval",
+                            &cfg->migrationTelemetryInterval) < 0)
+        return -1;
+    if (cfg->migrationTelemetryInterval == 0) {
+        virReportError(VIR_ERR_CONF_SYNTAX,
+                       _("%s: migration_telemetry_interval must be greater "
+                         "than 0"),
+                       filename);
+        return -1;
+    }
+
+    if (virConfGetValueUInt(conf, "migration_auto_switchover_ratio",
+                            &cfg->migrationAutoSwitchoverRatio) < 0)
+        return -1;
+    if (virConfGetValueUInt(conf, "migration_auto_switchover_iterations",
+                            &cfg->migrationAutoSwitchoverIterations) < 0)
+        return -1;
+
+    if (virConfGetValueUInt(conf, "migration_auto_switchover_throttle",
+                            &cfg->migrationAutoSwitchoverThrottle) < 0)
+        return -1;
+    if (cfg->migrationAutoSwitchoverThrottle > 100) {
+        virReportError(VIR_ERR_CONF_SYNTAX,
+                       _("%s: migration_auto_switchover_throttle must be "
+                         "between 0 and 100"),
+                       filename);
+        return -1;
+    }
+
+    if (virConfGetValueUInt(conf, "migration_nbd_buffer_size",
+                            &cfg->migrationNBDBufferSize) < 0)
+        return -1;
+
     return 0;
 }
 
@@ -195,6 +195,12 @@ struct _virQEMUDriverConfig {
     char *migrationAddress;
     unsigned int migrationPortMin;
     unsigned int migrationPortMax;
+    unsigned int migrationTelemetrySamples;
+    unsigned int migrationTelemetryInterval;
+    unsigned int migrationAutoSwitchoverRatio;
+    unsigned int migrationAutoSwitchoverIterations;
+    unsigned int migrationAutoSwitchoverThrottle;
+    unsigned int migrationNBDBufferSize;
 
     bool logTimestamp;
     bool stdioLogD;
@@ -408,6 +408,8 @@ qemuDomainObjFreeJob(qemuDomainObjPrivatePtr priv)
     qemuDomainObjResetAsyncJob(priv);
     VIR_FREE(priv->job.current);
     VIR_FREE(priv->job.completed);
+    qemuDomainJobTelemetryFree(priv->job.telemetry);
+    priv->job.telemetry = NULL;
     virCondDestroy(&priv->job.cond);
     virCondDestroy(&priv->job.asyncCond);
 }
@@ -680,6 +682,12 @@ qemuDomainMigrationJobInfoToParams(qemuDomainJobInfoPtr jobInfo,
                                 stats->disk_bps) < 0)
         goto error;
 
+    if (jobInfo->tunnelBps &&
+        virTypedParamsAddULLong(&par, &npar, &maxpar,
+                                VIR_DOMAIN_JOB_TUNNEL_BPS,
+                                jobInfo->tunnelBps) < 0)
+        goto error;
+
     if (stats->xbzrle_set) {
         if (virTypedParamsAddULLong(&par, &npar, &maxpar,
                                     VIR_DOMAIN_JOB_COMPRESSION_CACHE,
@@ -705,6 +713,15 @@ qemuDomainMigrationJobInfoToParams(qemuDomainJobInfoPtr jobInfo,
                              stats->cpu_throttle_percentage) < 0)
         goto error;
 
+    if (jobInfo->autoSwitchover != VIR_DOMAIN_JOB_AUTO_SWITCHOVER_NONE &&
+        (virTypedParamsAddInt(&par, &npar, &maxpar,
+                              VIR_DOMAIN_JOB_AUTO_SWITCHOVER,
+                              jobInfo->autoSwitchover) < 0 ||
+         virTypedParamsAddULLong(&par, &npar, &maxpar,
+                                 VIR_DOMAIN_JOB_AUTO_SWITCHOVER_ITERATION,
+                                 jobInfo->autoSwitchoverIteration) < 0))
+        goto error;
+
  done:
     *type = qemuDomainJobStatusToType(jobInfo->status);
     *params = par;
@@ -844,6 +861,147 @@ qemuDomainJobInfoToParams(qemuDomainJobInfoPtr jobInfo,
 }
 
 
+qemuDomainJobTelemetryPtr
+qemuDomainJobTelemetryNew(size_t nsamples,
+                          unsigned int interval)
+{
+    qemuDomainJobTelemetryPtr telemetry = g_new0(qemuDomainJobTelemetry, 1);
+
+    telemetry->interval = interval;
+    telemetry->nsamples = nsamples;
+    telemetry->samples = g_new0(qemuDomainJobTelemetrySample, nsamples);
+
+    return telemetry;
+}
+
+
+void
+qemuDomainJobTelemetryFree(qemuDomainJobTelemetryPtr telemetry)
+{
+    if (!telemetry)
+        return;
+
+    g_free(telemetry->samples);
+    g_free(telemetry);
+}
+
+
+/**
+ * qemuDomainJobTelemetryWanted:
+ * @telemetry: job telemetry (may be NULL)
+ * @now: current time in milliseconds
+ *
+ * Returns true if a new sample should be recorded at @now.
+ */
+bool
+qemuDomainJobTelemetryWanted(qemuDomainJobTelemetryPtr telemetry,
+                             unsigned long long now)
+{
+    if (!telemetry || telemetry->nsamples == 0)
+        return false;
+
+    return now >= telemetry->last + telemetry->interval;
+}
+
+
+/**
+ * qemuDomainJobTelemetryRecord:
+ * @telemetry: job telemetry
+ * @jobInfo: job info with migration statistics freshly fetched from QEMU
+ * @now: current time in milliseconds
+ *
+ * Stores a sample of @jobInfo in the ring buffer overwriting the oldest
+ * sample if the buffer is full.
+ */
+void
+qemuDomainJobTelemetryRecord(qemuDomainJobTelemetryPtr telemetry,
+                             qemuDomainJobInfoPtr jobInfo,
+                             unsigned long long now)
+{
+    qemuMonitorMigrationStats *stats = &jobInfo->stats.mig;
+    qemuDomainMirrorStatsPtr mirrorStats = &jobInfo->mirrorStats;
+    qemuDomainJobTelemetrySamplePtr sample;
+
+    if (telemetry->nsamples == 0)
+        return;
+
+    sample = telemetry->samples + telemetry->next;
+    sample->time = jobInfo->started && now > jobInfo->started ?
+                   now - jobInfo->started : 0;
+    sample->remaining = stats->ram_remaining + stats->disk_remaining;
+    if (mirrorStats->total > mirrorStats->transferred)
+        sample->remaining += mirrorStats->total - mirrorStats->transferred;
+    sample->dirtyRate = stats->ram_dirty_rate;
+    sample->bps = stats->ram_bps;
+    sample->iteration = stats->ram_iteration;
+    sample->downtime = stats->downtime_set ? stats->downtime : 0;
+
+    telemetry->next = (telemetry->next + 1) % telemetry->nsamples;
+    if (telemetry->count < telemetry->nsamples)
+        telemetry->count++;
+    telemetry->last = now;
+}
+
+
+#define QEMU_JOB_TELEMETRY_ADD_PARAM(num, field, value) \
+    do { \
+        g_snprintf(name, sizeof(name), "telemetry.%zu.%s", num, field); \
+        if (virTypedParamsAddULLong(params, nparams, &maxparams, \
+                                    name, value) < 0) \
+            return -1; \
+    } while (0)
+
+/**
+ * qemuDomainJobTelemetryToParams:
+ * @telemetry: job telemetry (may be NULL)
+ * @params: typed parameters to append the samples to
+ * @nparams: number of items in @params
+ *
+ * Appends the recorded samples, oldest first, to @params using the format
+ * documented for VIR_DOMAIN_JOB_TELEMETRY_COUNT.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+qemuDomainJobTelemetryToParams(qemuDomainJobTelemetryPtr telemetry,
+                               virTypedParameterPtr *params,
+                               int *nparams)
+{
+    char name[VIR_TYPED_PARAM_FIELD_LENGTH];
+    int maxparams = *nparams;
+    size_t count = 0;
+    size_t first = 0;
+    size_t i;
+
+    if (telemetry) {
+        count = telemetry->count;
+        first = (telemetry->next + telemetry->nsamples - count) %
+                telemetry->nsamples;
+    }
+
+    if (virTypedParamsAddUInt(params, nparams, &maxparams,
+                              VIR_DOMAIN_JOB_TELEMETRY_COUNT, count) < 0)
+        return -1;
+
+    for (i = 0; i < count; i++) {
+        qemuDomainJobTelemetrySamplePtr sample;
+
+        sample = telemetry->samples + (first + i) % telemetry->nsamples;
+
+        QEMU_JOB_TELEMETRY_ADD_PARAM(i, "time", sample->time);
+        QEMU_JOB_TELEMETRY_ADD_PARAM(i, "remaining", sample->remaining);
+        QEMU_JOB_TELEMETRY_ADD_PARAM(i, "dirty_rate", sample->dirtyRate);
+        QEMU_JOB_TELEMETRY_ADD_PARAM(i, "bps", sample->bps);
+        QEMU_JOB_TELEMETRY_ADD_PARAM(i, "iteration", sample->iteration);
+        QEMU_JOB_TELEMETRY_ADD_PARAM(i, "downtime", sample->downtime);
+    }
+
+    return 0;
+}
+
+#undef QEMU_JOB_TELEMETRY_ADD_PARAM
+
+
 /* qemuDomainGetMasterKeyFilePath:
  * @libDir: Directory path to domain lib files
  *
@@ -9487,6 +9645,12 @@ qemuDomainObjBeginJobInternal(virQEMUDriverPtr driver,
             priv->job.asyncOwnerAPI = virThreadJobGet();
             priv->job.asyncStarted = now;
             priv->job.current->started = now;
+
+            qemuDomainJobTelemetryFree(priv->job.telemetry);
+            priv->job.telemetry = NULL;
+            if (cfg->migrationTelemetrySamples > 0)
+                priv->job.telemetry = qemuDomainJobTelemetryNew(cfg->migrationTelemetrySamples,
+                                                                cfg->migrationTelemetryInterval);
         }
     }
 
@@ -10760,12 +10924,109 @@ qemuFindQemuImgBinary(virQEMUDriverPtr driver)
     return driver->qemuImgBinary;
 }
 
+/**
+ * qemuDomainMomentGetParseCaps:
+ * @driver: qemu driver
+ * @vm: domain object
+ * @emulator: emulator of the definition about to be parsed
+ * @capsCache: optional table of capabilities looked up so far
+ *
+ * Returns the capabilities to parse a snapshot or checkpoint definition of
+ * @vm using @emulator with, or NULL to let the parser look them up itself.
+ * Passing the same @capsCache while loading many definitions avoids
+ * revalidating the capabilities cache entry for each of them.
+ */
+virQEMUCapsPtr
+qemuDomainMomentGetParseCaps(virQEMUDriverPtr driver,
+                             virDomainObjPtr vm,
+                             const char *emulator,
+                             virHashTablePtr capsCache)
+{
+    qemuDomainObjPrivatePtr priv = vm->privateData;
+    virQEMUCapsPtr qemuCaps;
+
+    if (!emulator)
+        return NULL;
+
+    if (priv->qemuCaps &&
+        STREQ_NULLABLE(virQEMUCapsGetBinary(priv->qemuCaps), emulator))
+        return virObjectRef(priv->qemuCaps);
+
+    if (capsCache && (qemuCaps = virHashLookup(capsCache, emulator)))
+        return virObjectRef(qemuCaps);
+
+    /* Leave it to the parser if they can't be found */
+    if (!(qemuCaps = virQEMUCapsCacheLookup(driver->qemuCapsCache, emulator))) {
+        virResetLastError();
+        return NULL;
+    }
+
+    if (capsCache) {
+        if (virHashAddEntry(capsCache, emulator, qemuCaps) < 0)
+            virResetLastError();
+        else
+            virObjectRef(qemuCaps);
+    }
+
+    return qemuCaps;
+}
+
+
+/* Parse the domain definitions left out when loading the metadata of
+ * the snapshot @def from the metadata file in @snapDir. */
+static int
+qemuDomainSnapshotParseDomains(virQEMUDriverPtr driver,
+                               virDomainObjPtr vm,
+                               virDomainSnapshotDefPtr def,
+                               const char *snapDir)
+{
+    g_autofree char *snapFile = NULL;
+    g_autofree char *emulator = NULL;
+    g_autoptr(xmlDoc) xml = NULL;
+    g_autoptr(xmlXPathContext) ctxt = NULL;
+    g_autoptr(virQEMUCaps) qemuCaps = NULL;
+    g_autoptr(virDomainSnapshotDef) loaded = NULL;
+    int keepBlanksDefault = xmlKeepBlanksDefault(0);
+    bool cur;
+
+    snapFile = g_strdup_printf("%s/%s.xml", snapDir, def->parent.name);
+
+    xml = virXMLParseFileCtxt(snapFile, &ctxt);
+    xmlKeepBlanksDefault(keepBlanksDefault);
+    if (!xml)
+        return -1;
+
+    emulator = virXPathString("string(./domain/devices/emulator)", ctxt);
+    qemuCaps = qemuDomainMomentGetParseCaps(driver, vm, emulator, NULL);
+
+    if (!(loaded = virDomainSnapshotDefParseNode(xml, ctxt->node,
+                                                 driver->xmlopt, qemuCaps, &cur,
+                                                 VIR_DOMAIN_SNAPSHOT_PARSE_REDEFINE |
+                                                 VIR_DOMAIN_SNAPSHOT_PARSE_DISKS |
+                                                 VIR_DOMAIN_SNAPSHOT_PARSE_INTERNAL)))
+        return -1;
+
+    if (STRNEQ(loaded->parent.name, def->parent.name)) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("snapshot metadata '%s' belongs to snapshot '%s'"),
+                       snapFile, loaded->parent.name);
+        return -1;
+    }
+
+    def->parent.dom = g_steal_pointer(&loaded->parent.dom);
+    def->parent.inactiveDom = g_steal_pointer(&loaded->parent.inactiveDom);
+    def->domainDeferred = false;
+    return 0;
+}
+
+
 int
 qemuDomainSnapshotWriteMetadata(virDomainObjPtr vm,
                                 virDomainMomentObjPtr snapshot,
                                 virDomainXMLOptionPtr xmlopt,
                                 const char *snapshotDir)
 {
+    qemuDomainObjPrivatePtr priv = vm->privateData;
     char *newxml = NULL;
     int ret = -1;
     char *snapDir = NULL;
@@ -10774,15 +11035,23 @@ qemuDomainSnapshotWriteMetadata(virDomainObjPtr vm,
     unsigned int flags = VIR_DOMAIN_SNAPSHOT_FORMAT_SECURE |
         VIR_DOMAIN_SNAPSHOT_FORMAT_INTERNAL;
     virDomainSnapshotDefPtr def = virDomainSnapshotObjGetDef(snapshot);
+    bool deferred = def->domainDeferred;
+
+    snapDir = g_strdup_printf("%s/%s", snapshotDir, vm->def->name);
+
+    /* The metadata always embeds the domain definitions, so parse them
+     * again if they were left out when loading it */
+    if (deferred &&
+        qemuDomainSnapshotParseDomains(priv->driver, vm, def, snapDir) < 0)
+        goto cleanup;
 
     if (virDomainSnapshotGetCurrent(vm->snapshots) == snapshot)
         flags |= VIR_DOMAIN_SNAPSHOT_FORMAT_CURRENT;
     virUUIDFormat(vm->def->uuid, uuidstr);
     newxml = virDomainSnapshotDefFormat(uuidstr, def, xmlopt, flags);
     if (newxml == NULL)
-        return -1;
+        goto cleanup;
 
-    snapDir = g_strdup_printf("%s/%s", snapshotDir, vm->def->name);
     if (virFileMakePath(snapDir) < 0) {
         virReportSystemError(errno, _("cannot create snapshot directory '%s'"),
                              snapDir);
@@ -10794,6 +11063,8 @@ qemuDomainSnapshotWriteMetadata(virDomainObjPtr vm,
     ret = virXMLSaveFile(snapFile, NULL, "snapshot-edit", newxml);
 
  cleanup:
+    if (deferred)
+        qemuDomainSnapshotUnloadDomains(snapshot);
     VIR_FREE(snapFile);
     VIR_FREE(snapDir);
     VIR_FREE(newxml);
@@ -10801,6 +11072,60 @@ qemuDomainSnapshotWriteMetadata(virDomainObjPtr vm,
 }
 
 
+/**
+ * qemuDomainSnapshotLoadDomains:
+ * @driver: qemu driver
+ * @vm: domain object
+ * @snapshot: snapshot of @vm
+ *
+ * The domain definitions embedded in snapshot metadata are not parsed when
+ * the metadata is loaded. Parse them from the metadata file of @snapshot if
+ * that wasn't done yet. Returns 0 on success, -1 on error.
+ */
+int
+qemuDomainSnapshotLoadDomains(virQEMUDriverPtr driver,
+                              virDomainObjPtr vm,
+                              virDomainMomentObjPtr snapshot)
+{
+    g_autoptr(virQEMUDriverConfig) cfg = virQEMUDriverGetConfig(driver);
+    g_autofree char *snapDir = NULL;
+
+    if (!virDomainSnapshotObjGetDef(snapshot)->domainDeferred)
+        return 0;
+
+    snapDir = g_strdup_printf("%s/%s", cfg->snapshotDir, vm->def->name);
+
+    return qemuDomainSnapshotParseDomains(driver, vm,
+                                          virDomainSnapshotObjGetDef(snapshot),
+                                          snapDir);
+}
+
+
+/**
+ * qemuDomainSnapshotUnloadDomains:
+ * @snapshot: snapshot whose metadata is saved
+ *
+ * Free the domain definitions of @snapshot once they are no longer used.
+ * qemuDomainSnapshotLoadDomains parses them again from the metadata file
+ * when they are needed.
+ */
+void
+qemuDomainSnapshotUnloadDomains(virDomainMomentObjPtr snapshot)
+{
+    virDomainSnapshotDefPtr def = virDomainSnapshotObjGetDef(snapshot);
+
+    /* snapshots taken prior to libvirt 0.9.5 have no definition */
+    if (!def->parent.dom && !def->parent.inactiveDom)
+        return;
+
+    virDomainDefFree(def->parent.dom);
+    def->parent.dom = NULL;
+    virDomainDefFree(def->parent.inactiveDom);
+    def->parent.inactiveDom = NULL;
+    def->domainDeferred = true;
+}
+
+
 /* The domain is expected to be locked and inactive. Return -1 on normal
  * failure, 1 if we skipped a disk due to try_all.  */
 static int
@@ -10885,12 +11210,22 @@ qemuDomainSnapshotForEachQcow2(virQEMUDriverPtr driver,
     /* Prefer action on the disks in use at the time the snapshot was
      * created; but fall back to current definition if dealing with a
      * snapshot created prior to libvirt 0.9.5.  */
-    virDomainDefPtr def = snap->def->dom;
+    virDomainDefPtr def;
+    bool deferred = virDomainSnapshotObjGetDef(snap)->domainDeferred;
+    int ret;
 
-    if (!def)
+    if (qemuDomainSnapshotLoadDomains(driver, vm, snap) < 0)
+        return -1;
+
+    if (!(def = snap->def->dom))
         def = vm->def;
-    return qemuDomainSnapshotForEachQcow2Raw(driver, def, snap->def->name,
-                                             op, try_all, def->ndisks);
+    ret = qemuDomainSnapshotForEachQcow2Raw(driver, def, snap->def->name,
+                                            op, try_all, def->ndisks);
+
+    if (deferred)
+        qemuDomainSnapshotUnloadDomains(snap);
+
+    return ret;
 }
 
 /* Discard one snapshot (or its metadata), without reparenting any children.  */
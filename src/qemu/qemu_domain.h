@@ -173,6 +173,34 @@ struct _qemuDomainJobInfo {
         qemuDomainBackupStats backup;
     } stats;
     qemuDomainMirrorStats mirrorStats;
+    /* Action taken by the automatic switchover policy */
+    virDomainJobAutoSwitchover autoSwitchover;
+    unsigned long long autoSwitchoverIteration;
+    /* Average throughput of migration tunnel */
+    unsigned long long tunnelBps;
+};
+
+typedef struct _qemuDomainJobTelemetrySample qemuDomainJobTelemetrySample;
+typedef qemuDomainJobTelemetrySample *qemuDomainJobTelemetrySamplePtr;
+struct _qemuDomainJobTelemetrySample {
+    unsigned long long time; /* milliseconds since the job started */
+    unsigned long long remaining;
+    unsigned long long dirtyRate;
+    unsigned long long bps;
+    unsigned long long iteration;
+    unsigned long long downtime; /* expected downtime */
+};
+
+/* Ring buffer of progress samples of an async job */
+typedef struct _qemuDomainJobTelemetry qemuDomainJobTelemetry;
+typedef qemuDomainJobTelemetry *qemuDomainJobTelemetryPtr;
+struct _qemuDomainJobTelemetry {
+    unsigned int interval;          /* minimum time between samples in ms */
+    unsigned long long last;        /* when the last sample was recorded */
+    size_t next;                    /* index of the next sample to write */
+    size_t count;                   /* number of valid samples */
+    size_t nsamples;
+    qemuDomainJobTelemetrySamplePtr samples;
 };
 
 typedef struct _qemuDomainJobObj qemuDomainJobObj;
@@ -211,6 +239,9 @@ struct _qemuDomainJobObj {
 
     qemuMigrationParamsPtr migParams;
     unsigned long apiFlags; /* flags passed to the API which started the async job */
+
+    qemuDomainJobTelemetryPtr telemetry; /* progress history of the last
+                                            async job (if enabled) */
 };
 
 typedef void (*qemuDomainCleanupCallback)(virQEMUDriverPtr driver,
@@ -794,6 +825,17 @@ int qemuDomainSnapshotWriteMetadata(virDomainObjPtr vm,
                                     virDomainXMLOptionPtr xmlopt,
                                     const char *snapshotDir);
 
+int qemuDomainSnapshotLoadDomains(virQEMUDriverPtr driver,
+                                  virDomainObjPtr vm,
+                                  virDomainMomentObjPtr snapshot);
+
+void qemuDomainSnapshotUnloadDomains(virDomainMomentObjPtr snapshot);
+
+virQEMUCapsPtr qemuDomainMomentGetParseCaps(virQEMUDriverPtr driver,
+                                            virDomainObjPtr vm,
+                                            const char *emulator,
+                                            virHashTablePtr capsCache);
+
 int qemuDomainSnapshotForEachQcow2(virQEMUDriverPtr driver,
                                    virDomainObjPtr vm,
                                    virDomainMomentObjPtr snap,
@@ -955,6 +997,20 @@ int qemuDomainJobInfoToParams(qemuDomainJobInfoPtr jobInfo,
     ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2)
     ATTRIBUTE_NONNULL(3) ATTRIBUTE_NONNULL(4);
 
+qemuDomainJobTelemetryPtr qemuDomainJobTelemetryNew(size_t nsamples,
+                                                    unsigned int interval);
+void qemuDomainJobTelemetryFree(qemuDomainJobTelemetryPtr telemetry);
+bool qemuDomainJobTelemetryWanted(qemuDomainJobTelemetryPtr telemetry,
+                                  unsigned long long now);
+void qemuDomainJobTelemetryRecord(qemuDomainJobTelemetryPtr telemetry,
+                                  qemuDomainJobInfoPtr jobInfo,
+                                  unsigned long long now)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2);
+int qemuDomainJobTelemetryToParams(qemuDomainJobTelemetryPtr telemetry,
+                                   virTypedParameterPtr *params,
+                                   int *nparams)
+    ATTRIBUTE_NONNULL(2) ATTRIBUTE_NONNULL(3);
+
 bool qemuDomainDiskBlockJobIsActive(virDomainDiskDefPtr disk);
 bool qemuDomainHasBlockjob(virDomainObjPtr vm, bool copy_only)
     ATTRIBUTE_NONNULL(1);
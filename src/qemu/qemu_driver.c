@@ -370,6 +370,35 @@ qemuSecurityInit(virQEMUDriverPtr driver)
 }
 
 
+/* Parse the snapshot or checkpoint XML in @xmlStr for @vm. The parser
+ * is given the capabilities of the emulator of the domain definition in it
+ * from @capsCache, so that they aren't looked up and revalidated separately
+ * for each of the possibly thousands of definitions. */
+static xmlDocPtr
+qemuDomainMomentLoadParse(virDomainObjPtr vm,
+                          const char *xmlStr,
+                          const char *filename,
+                          virHashTablePtr capsCache,
+                          xmlXPathContextPtr *ctxt,
+                          virQEMUCapsPtr *qemuCaps)
+{
+    xmlDocPtr xml;
+    int keepBlanksDefault = xmlKeepBlanksDefault(0);
+    g_autofree char *emulator = NULL;
+
+    xml = virXMLParseStringCtxt(xmlStr, filename, ctxt);
+    xmlKeepBlanksDefault(keepBlanksDefault);
+    if (!xml)
+        return NULL;
+
+    emulator = virXPathString("string(./domain/devices/emulator)", *ctxt);
+    *qemuCaps = qemuDomainMomentGetParseCaps(qemu_driver, vm, emulator,
+                                             capsCache);
+
+    return xml;
+}
+
+
 static int
 qemuDomainSnapshotLoad(virDomainObjPtr vm,
                        void *data)
@@ -384,15 +413,13 @@ qemuDomainSnapshotLoad(virDomainObjPtr vm,
     bool cur;
     unsigned int flags = (VIR_DOMAIN_SNAPSHOT_PARSE_REDEFINE |
                           VIR_DOMAIN_SNAPSHOT_PARSE_DISKS |
-                          VIR_DOMAIN_SNAPSHOT_PARSE_INTERNAL);
+                          VIR_DOMAIN_SNAPSHOT_PARSE_INTERNAL |
+                          VIR_DOMAIN_SNAPSHOT_PARSE_DEFER_DOMAIN);
     int ret = -1;
     int direrr;
-    qemuDomainObjPrivatePtr priv;
 
     virObjectLock(vm);
 
-    priv = vm->privateData;
-
     if (!(snapDir = g_strdup_printf("%s/%s", baseDir, vm->def->name))) {
         virReportError(VIR_ERR_INTERNAL_ERROR,
                        _("Failed to allocate memory for "
@@ -429,9 +456,10 @@ qemuDomainSnapshotLoad(virDomainObjPtr vm,
             continue;
         }
 
+        /* The domain definitions are parsed when they are needed */
         def = virDomainSnapshotDefParseString(xmlStr,
                                               qemu_driver->xmlopt,
-                                              priv->qemuCaps, &cur,
+                                              NULL, &cur,
                                               flags);
         if (def == NULL) {
             /* Nothing we can do here, skip this one */
@@ -496,10 +524,12 @@ qemuDomainCheckpointLoad(virDomainObjPtr vm,
     unsigned int flags = VIR_DOMAIN_CHECKPOINT_PARSE_REDEFINE;
     int ret = -1;
     int direrr;
-    qemuDomainObjPrivatePtr priv;
+    g_autoptr(virHashTable) capsCache = NULL;
 
     virObjectLock(vm);
-    priv = vm->privateData;
+
+    if (!(capsCache = virHashNew(virObjectFreeHashData)))
+        goto cleanup;
 
     if (!(chkDir = g_strdup_printf("%s/%s", baseDir, vm->def->name))) {
         virReportError(VIR_ERR_INTERNAL_ERROR,
@@ -518,6 +548,9 @@ qemuDomainCheckpointLoad(virDomainObjPtr vm,
     while ((direrr = virDirRead(dir, &entry, NULL)) > 0) {
         g_autofree char *xmlStr = NULL;
         g_autofree char *fullpath = NULL;
+        g_autoptr(xmlDoc) xml = NULL;
+        g_autoptr(xmlXPathContext) ctxt = NULL;
+        g_autoptr(virQEMUCaps) qemuCaps = NULL;
 
         /* NB: ignoring errors, so one malformed config doesn't
            kill the whole process */
@@ -537,10 +570,13 @@ qemuDomainCheckpointLoad(virDomainObjPtr vm,
             continue;
         }
 
-        def = virDomainCheckpointDefParseString(xmlStr,
-                                                qemu_driver->xmlopt,
-                                                priv->qemuCaps,
-                                                flags);
+        if ((xml = qemuDomainMomentLoadParse(vm, xmlStr, fullpath, capsCache,
+                                             &ctxt, &qemuCaps)))
+            def = virDomainCheckpointDefParseNode(xml, ctxt->node,
+                                                  qemu_driver->xmlopt,
+                                                  qemuCaps, flags);
+        else
+            def = NULL;
         if (!def || virDomainCheckpointAlignDisks(def) < 0) {
             /* Nothing we can do here, skip this one */
             virReportError(VIR_ERR_INTERNAL_ERROR,
@@ -2777,6 +2813,7 @@ typedef enum {
      */
     QEMU_SAVE_FORMAT_XZ = 3,
     QEMU_SAVE_FORMAT_LZOP = 4,
+    QEMU_SAVE_FORMAT_ZSTD = 5,
     /* Note: add new members only at the end.
        These values are used in the on-disk format.
        Do not change or re-use numbers. */
@@ -2792,6 +2829,7 @@ VIR_ENUM_IMPL(qemuSaveCompression,
               "bzip2",
               "xz",
               "lzop",
+              "zstd",
 );
 
 VIR_ENUM_DECL(qemuDumpFormat);
@@ -3452,6 +3490,10 @@ qemuGetCompressionProgram(const char *imageFormat,
     virCommandAddArg(*compressor, "-c");
     if (ret == QEMU_SAVE_FORMAT_XZ)
         virCommandAddArg(*compressor, "-3");
+    /* Spread compression over all host CPUs so that saving large
+     * guests is not bound by a single compressor thread. */
+    if (ret == QEMU_SAVE_FORMAT_ZSTD)
+        virCommandAddArg(*compressor, "-T0");
 
     return ret;
 
@@ -13989,7 +14031,8 @@ qemuDomainGetJobStats(virDomainPtr dom,
     int ret = -1;
 
     virCheckFlags(VIR_DOMAIN_JOB_STATS_COMPLETED |
-                  VIR_DOMAIN_JOB_STATS_KEEP_COMPLETED, -1);
+                  VIR_DOMAIN_JOB_STATS_KEEP_COMPLETED |
+                  VIR_DOMAIN_JOB_STATS_TELEMETRY, -1);
 
     if (!(vm = qemuDomainObjFromDomain(dom)))
         goto cleanup;
@@ -14011,6 +14054,16 @@ qemuDomainGetJobStats(virDomainPtr dom,
 
     ret = qemuDomainJobInfoToParams(&jobInfo, type, params, nparams);
 
+    if (ret == 0 && (flags & VIR_DOMAIN_JOB_STATS_TELEMETRY) &&
+        qemuDomainJobTelemetryToParams(priv->job.telemetry,
+                                       params, nparams) < 0) {
+        virTypedParamsFree(*params, *nparams);
+        *params = NULL;
+        *nparams = 0;
+        ret = -1;
+        goto cleanup;
+    }
+
     if (completed && ret == 0 && !(flags & VIR_DOMAIN_JOB_STATS_KEEP_COMPLETED))
         VIR_FREE(priv->job.completed);
 
@@ -14496,7 +14549,6 @@ qemuDomainMigrateStartPostCopy(virDomainPtr dom,
 {
     virQEMUDriverPtr driver = dom->conn->privateData;
     virDomainObjPtr vm;
-    qemuDomainObjPrivatePtr priv;
     int ret = -1;
 
     virCheckFlags(0, -1);
@@ -14510,32 +14562,8 @@ qemuDomainMigrateStartPostCopy(virDomainPtr dom,
     if (qemuDomainObjBeginJob(driver, vm, QEMU_JOB_MIGRATION_OP) < 0)
         goto cleanup;
 
-    if (virDomainObjCheckActive(vm) < 0)
-        goto endjob;
+    ret = qemuMigrationSrcStartPostCopy(driver, vm, QEMU_ASYNC_JOB_NONE);
 
-    priv = vm->privateData;
-
-    if (priv->job.asyncJob != QEMU_ASYNC_JOB_MIGRATION_OUT) {
-        virReportError(VIR_ERR_OPERATION_INVALID, "%s",
-                       _("post-copy can only be started while "
-                         "outgoing migration is in progress"));
-        goto endjob;
-    }
-
-    if (!(priv->job.apiFlags & VIR_MIGRATE_POSTCOPY)) {
-        virReportError(VIR_ERR_OPERATION_INVALID, "%s",
-                       _("switching to post-copy requires migration to be "
-                         "started with VIR_MIGRATE_POSTCOPY flag"));
-        goto endjob;
-    }
-
-    VIR_DEBUG("Starting post-copy");
-    qemuDomainObjEnterMonitor(driver, vm);
-    ret = qemuMonitorMigrateStartPostCopy(priv->mon);
-    if (qemuDomainObjExitMonitor(driver, vm) < 0)
-        ret = -1;
-
- endjob:
     qemuDomainObjEndJob(driver, vm);
 
  cleanup:
@@ -16007,10 +16035,21 @@ qemuDomainSnapshotCreateXML(virDomainPtr domain,
     qemuDomainObjSetAsyncJobMask(vm, QEMU_JOB_NONE);
 
     if (redefine) {
+        virDomainMomentObjPtr other;
+
+        /* The definition of the snapshot being replaced may be reused */
+        if ((other = virDomainSnapshotFindByName(vm->snapshots,
+                                                 def->parent.name)) &&
+            qemuDomainSnapshotLoadDomains(driver, vm, other) < 0)
+            goto endjob;
+
         if (virDomainSnapshotRedefinePrep(vm, &def, &snap,
                                           driver->xmlopt,
-                                          flags) < 0)
+                                          flags) < 0) {
+            if (other)
+                qemuDomainSnapshotUnloadDomains(other);
             goto endjob;
+        }
     } else {
         /* Easiest way to clone inactive portion of vm->def is via
          * conversion in and back out of xml.  */
@@ -16133,6 +16172,8 @@ qemuDomainSnapshotCreateXML(virDomainPtr domain,
             virDomainSnapshotObjListRemove(vm->snapshots, snap);
         } else {
             virDomainSnapshotLinkParent(vm->snapshots, snap);
+            /* the saved metadata keeps the definitions until needed */
+            qemuDomainSnapshotUnloadDomains(snap);
         }
     } else if (snap) {
         virDomainSnapshotObjListRemove(vm->snapshots, snap);
@@ -16442,6 +16483,7 @@ qemuDomainSnapshotGetXMLDesc(virDomainSnapshotPtr snapshot,
     char *xml = NULL;
     virDomainMomentObjPtr snap = NULL;
     char uuidstr[VIR_UUID_STRING_BUFLEN];
+    bool deferred;
 
     virCheckFlags(VIR_DOMAIN_SNAPSHOT_XML_SECURE, NULL);
 
@@ -16454,12 +16496,19 @@ qemuDomainSnapshotGetXMLDesc(virDomainSnapshotPtr snapshot,
     if (!(snap = qemuSnapObjFromSnapshot(vm, snapshot)))
         goto cleanup;
 
+    deferred = virDomainSnapshotObjGetDef(snap)->domainDeferred;
+    if (qemuDomainSnapshotLoadDomains(driver, vm, snap) < 0)
+        goto cleanup;
+
     virUUIDFormat(snapshot->domain->uuid, uuidstr);
 
     xml = virDomainSnapshotDefFormat(uuidstr, virDomainSnapshotObjGetDef(snap),
                                      driver->xmlopt,
                                      virDomainSnapshotFormatConvertXMLFlags(flags));
 
+    if (deferred)
+        qemuDomainSnapshotUnloadDomains(snap);
+
  cleanup:
     virDomainObjEndAPI(&vm);
     return xml;
@@ -16558,6 +16607,7 @@ qemuDomainRevertToSnapshot(virDomainSnapshotPtr snapshot,
     unsigned int start_flags = VIR_QEMU_PROCESS_START_GEN_VMID;
     qemuDomainAsyncJob jobType = QEMU_ASYNC_JOB_START;
     bool defined = false;
+    bool deferred = false;
 
     virCheckFlags(VIR_DOMAIN_SNAPSHOT_REVERT_RUNNING |
                   VIR_DOMAIN_SNAPSHOT_REVERT_PAUSED |
@@ -16603,6 +16653,10 @@ qemuDomainRevertToSnapshot(virDomainSnapshotPtr snapshot,
         goto endjob;
     snapdef = virDomainSnapshotObjGetDef(snap);
 
+    deferred = snapdef->domainDeferred;
+    if (qemuDomainSnapshotLoadDomains(driver, vm, snap) < 0)
+        goto endjob;
+
     if (!vm->persistent &&
         snapdef->state != VIR_DOMAIN_SNAPSHOT_RUNNING &&
         snapdef->state != VIR_DOMAIN_SNAPSHOT_PAUSED &&
@@ -16962,6 +17016,8 @@ qemuDomainRevertToSnapshot(virDomainSnapshotPtr snapshot,
             ret = -1;
         }
     }
+    if (deferred)
+        qemuDomainSnapshotUnloadDomains(snap);
     if (ret == 0 && defined && vm->persistent &&
         !(ret = virDomainDefSave(vm->newDef ? vm->newDef : vm->def,
                                  driver->xmlopt, cfg->configDir))) {
@@ -28,6 +28,8 @@
 #include <poll.h>
 
 #include "qemu_migration.h"
+#define LIBVIRT_QEMU_MIGRATIONPRIV_H_ALLOW
+#include "qemu_migrationpriv.h"
 #include "qemu_migration_cookie.h"
 #include "qemu_migration_params.h"
 #include "qemu_monitor.h"
@@ -54,11 +56,13 @@
 #include "virtime.h"
 #include "locking/domain_lock.h"
 #include "rpc/virnetsocket.h"
+#include "rpc/virnetprotocol.h"
 #include "virstoragefile.h"
 #include "viruri.h"
 #include "virhook.h"
 #include "virstring.h"
 #include "virtypedparam.h"
+#include "virutil.h"
 #include "virprocess.h"
 #include "nwfilter_conf.h"
 #include "virdomainsnapshotobjlist.h"
@@ -824,6 +828,7 @@ qemuMigrationSrcNBDStorageCopyBlockdev(virQEMUDriverPtr driver,
                                        const char *host,
                                        int port,
                                        unsigned long long mirror_speed,
+                                       unsigned long long mirror_buf_size,
                                        unsigned int mirror_shallow,
                                        const char *tlsAlias)
 {
@@ -853,7 +858,8 @@ qemuMigrationSrcNBDStorageCopyBlockdev(virQEMUDriverPtr driver,
     if (mon_ret == 0)
         mon_ret = qemuMonitorBlockdevMirror(qemuDomainGetMonitor(vm), jobname, persistjob,
                                             sourcename, copysrc->nodeformat,
-                                            mirror_speed, 0, 0, mirror_shallow);
+                                            mirror_speed, 0, mirror_buf_size,
+                                            mirror_shallow);
 
     if (mon_ret != 0)
         qemuBlockStorageSourceAttachRollback(qemuDomainGetMonitor(vm), data);
@@ -874,6 +880,7 @@ qemuMigrationSrcNBDStorageCopyDriveMirror(virQEMUDriverPtr driver,
                                           const char *host,
                                           int port,
                                           unsigned long long mirror_speed,
+                                          unsigned long long mirror_buf_size,
                                           bool mirror_shallow)
 {
     g_autofree char *nbd_dest = NULL;
@@ -893,7 +900,8 @@ qemuMigrationSrcNBDStorageCopyDriveMirror(virQEMUDriverPtr driver,
 
     mon_ret = qemuMonitorDriveMirror(qemuDomainGetMonitor(vm),
                                      diskAlias, nbd_dest, "raw",
-                                     mirror_speed, 0, 0, mirror_shallow, true);
+                                     mirror_speed, 0, mirror_buf_size,
+                                     mirror_shallow, true);
 
     if (qemuDomainObjExitMonitor(driver, vm) < 0 || mon_ret < 0)
         return -1;
@@ -909,6 +917,7 @@ qemuMigrationSrcNBDStorageCopyOne(virQEMUDriverPtr driver,
                                   const char *host,
                                   int port,
                                   unsigned long long mirror_speed,
+                                  unsigned long long mirror_buf_size,
                                   bool mirror_shallow,
                                   const char *tlsAlias,
                                   unsigned int flags)
@@ -948,12 +957,14 @@ qemuMigrationSrcNBDStorageCopyOne(virQEMUDriverPtr driver,
                                                     sourcename, persistjob,
                                                     host, port,
                                                     mirror_speed,
+                                                    mirror_buf_size,
                                                     mirror_shallow,
                                                     tlsAlias);
     } else {
         rc = qemuMigrationSrcNBDStorageCopyDriveMirror(driver, vm, diskAlias,
                                                        host, port,
                                                        mirror_speed,
+                                                       mirror_buf_size,
                                                        mirror_shallow);
     }
 
@@ -972,6 +983,176 @@ qemuMigrationSrcNBDStorageCopyOne(virQEMUDriverPtr driver,
 }
 
 
+/* How often bandwidth is redistributed among disk mirrors */
+#define QEMU_MIGRATION_NBD_BALANCE_INTERVAL 1000
+
+/* Mirrors which are ready only follow guest writes. Together they get at
+ * most 1/QEMU_MIGRATION_NBD_READY_SHARE of the bandwidth while others are
+ * still copying. */
+#define QEMU_MIGRATION_NBD_READY_SHARE 20
+
+/**
+ * qemuMigrationSrcNBDStorageCopyShares:
+ * @speed: bandwidth limit for all mirrors in bytes/s
+ * @remaining: amount of data each mirror still has to copy, 0 if ready
+ * @shares: filled with the bandwidth of each mirror in bytes/s
+ * @nmirrors: number of mirrors
+ *
+ * Splits @speed among @nmirrors disk mirrors. Ready mirrors get a small
+ * share to keep up with guest writes, the rest is distributed among the
+ * mirrors performing the initial copy proportionally to the amount of data
+ * each of them still has to transfer, so that they all get ready at about
+ * the same time. Once all mirrors are ready they share @speed evenly.
+ *
+ * The shares add up to at most @speed, except that each mirror gets at
+ * least 1 B/s because QEMU treats 0 as unlimited.
+ */
+void
+qemuMigrationSrcNBDStorageCopyShares(unsigned long long speed,
+                                     const unsigned long long *remaining,
+                                     unsigned long long *shares,
+                                     size_t nmirrors)
+{
+    unsigned long long total = 0;
+    unsigned long long readyShare;
+    unsigned long long copyShare;
+    size_t nready = 0;
+    size_t i;
+
+    if (nmirrors == 0)
+        return;
+
+    for (i = 0; i < nmirrors; i++) {
+        if (remaining[i] == 0)
+            nready++;
+        else
+            total += remaining[i];
+    }
+
+    if (nready == nmirrors)
+        readyShare = speed / nmirrors;
+    else
+        readyShare = speed / QEMU_MIGRATION_NBD_READY_SHARE / nmirrors;
+
+    copyShare = speed - nready * readyShare;
+
+    for (i = 0; i < nmirrors; i++) {
+        if (remaining[i] == 0)
+            shares[i] = readyShare;
+        else
+            shares[i] = MIN((double) copyShare * remaining[i] / total,
+                            copyShare);
+
+        if (shares[i] == 0)
+            shares[i] = 1;
+    }
+}
+
+
+/**
+ * qemuMigrationSrcNBDStorageCopyBalance:
+ * @driver: qemu driver
+ * @vm: domain
+ * @speed: bandwidth limit for all mirrors in bytes/s
+ *
+ * Redistributes @speed among the disk mirrors according to
+ * qemuMigrationSrcNBDStorageCopyShares, so that the total bandwidth used
+ * by storage migration does not exceed @speed.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+static int
+qemuMigrationSrcNBDStorageCopyBalance(virQEMUDriverPtr driver,
+                                      virDomainObjPtr vm,
+                                      unsigned long long speed)
+{
+    qemuDomainObjPrivatePtr priv = vm->privateData;
+    virHashTablePtr blockinfo = NULL;
+    g_autofree virDomainDiskDefPtr *disks = NULL;
+    g_autofree unsigned long long *bandwidth = NULL;
+    g_autofree unsigned long long *remaining = NULL;
+    g_autofree unsigned long long *shares = NULL;
+    size_t nmirrors = 0;
+    size_t i;
+    int ret = -1;
+
+    if (qemuDomainObjEnterMonitorAsync(driver, vm,
+                                       QEMU_ASYNC_JOB_MIGRATION_OUT) < 0)
+        return -1;
+
+    blockinfo = qemuMonitorGetAllBlockJobInfo(priv->mon, false);
+
+    if (qemuDomainObjExitMonitor(driver, vm) < 0 || !blockinfo)
+        goto cleanup;
+
+    disks = g_new0(virDomainDiskDefPtr, vm->def->ndisks);
+    bandwidth = g_new0(unsigned long long, vm->def->ndisks);
+    remaining = g_new0(unsigned long long, vm->def->ndisks);
+    shares = g_new0(unsigned long long, vm->def->ndisks);
+
+    for (i = 0; i < vm->def->ndisks; i++) {
+        virDomainDiskDefPtr disk = vm->def->disks[i];
+        qemuMonitorBlockJobInfoPtr data;
+
+        if (!QEMU_DOMAIN_DISK_PRIVATE(disk)->migrating ||
+            !(data = virHashLookup(blockinfo, disk->info.alias)))
+            continue;
+
+        disks[nmirrors] = disk;
+        bandwidth[nmirrors] = data->bandwidth;
+        if (disk->mirrorState != VIR_DOMAIN_DISK_MIRROR_STATE_READY &&
+            data->end > data->cur)
+            remaining[nmirrors] = data->end - data->cur;
+        nmirrors++;
+    }
+
+    if (nmirrors == 0) {
+        ret = 0;
+        goto cleanup;
+    }
+
+    qemuMigrationSrcNBDStorageCopyShares(speed, remaining, shares, nmirrors);
+
+    if (qemuDomainObjEnterMonitorAsync(driver, vm,
+                                       QEMU_ASYNC_JOB_MIGRATION_OUT) < 0)
+        goto cleanup;
+
+    for (i = 0; i < nmirrors; i++) {
+        qemuBlockJobDataPtr job;
+        int rc;
+
+        /* avoid talking to QEMU for insignificant changes, but never let
+         * the total exceed the limit (0 means unlimited) */
+        if (bandwidth[i] > 0 &&
+            bandwidth[i] <= shares[i] &&
+            shares[i] - bandwidth[i] < shares[i] / 20)
+            continue;
+
+        if (!(job = qemuBlockJobDiskGetJob(disks[i])))
+            continue;
+
+        VIR_DEBUG("Setting bandwidth of mirror %s to %llu B/s",
+                  job->name, shares[i]);
+        rc = qemuMonitorBlockJobSetSpeed(priv->mon, job->name, shares[i]);
+        virObjectUnref(job);
+
+        if (rc < 0) {
+            ignore_value(qemuDomainObjExitMonitor(driver, vm));
+            goto cleanup;
+        }
+    }
+
+    if (qemuDomainObjExitMonitor(driver, vm) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    virHashFree(blockinfo);
+    return ret;
+}
+
+
 /**
  * qemuMigrationSrcNBDStorageCopy:
  * @driver: qemu driver
@@ -1007,8 +1188,12 @@ qemuMigrationSrcNBDStorageCopy(virQEMUDriverPtr driver,
     qemuDomainObjPrivatePtr priv = vm->privateData;
     int port;
     size_t i;
+    size_t ncopy = 0;
     unsigned long long mirror_speed = speed;
+    unsigned long long total_speed;
+    unsigned long long mirror_buf_size;
     bool mirror_shallow = *migrate_flags & QEMU_MONITOR_MIGRATE_NON_SHARED_INC;
+    bool balance = speed < QEMU_DOMAIN_MIG_BANDWIDTH_MAX;
     int rv;
     g_autoptr(virQEMUDriverConfig) cfg = virQEMUDriverGetConfig(driver);
 
@@ -1021,6 +1206,20 @@ qemuMigrationSrcNBDStorageCopy(virQEMUDriverPtr driver,
         return -1;
     }
     mirror_speed <<= 20;
+    total_speed = mirror_speed;
+    mirror_buf_size = (unsigned long long) cfg->migrationNBDBufferSize << 20;
+
+    for (i = 0; i < vm->def->ndisks; i++) {
+        if (qemuMigrationAnyCopyDisk(vm->def->disks[i],
+                                     nmigrate_disks, migrate_disks))
+            ncopy++;
+    }
+
+    /* The bandwidth limit applies to all mirrors together. They start with
+     * an equal share which is later rebalanced according to the amount of
+     * data each of them needs to copy. */
+    if (balance && ncopy > 1)
+        mirror_speed = MAX(mirror_speed / ncopy, 1);
 
     /* steal NBD port and thus prevent its propagation back to destination */
     port = mig->nbd->port;
@@ -1034,7 +1233,8 @@ qemuMigrationSrcNBDStorageCopy(virQEMUDriverPtr driver,
             continue;
 
         if (qemuMigrationSrcNBDStorageCopyOne(driver, vm, disk, host, port,
-                                              mirror_speed, mirror_shallow,
+                                              mirror_speed, mirror_buf_size,
+                                              mirror_shallow,
                                               tlsAlias, flags) < 0)
             return -1;
 
@@ -1062,8 +1262,28 @@ qemuMigrationSrcNBDStorageCopy(virQEMUDriverPtr driver,
             return -1;
         }
 
-        if (virDomainObjWait(vm) < 0)
+        if (balance && ncopy > 1) {
+            unsigned long long now;
+
+            if (qemuMigrationSrcNBDStorageCopyBalance(driver, vm,
+                                                      total_speed) < 0)
+                return -1;
+
+            if (virTimeMillisNow(&now) < 0)
+                return -1;
+
+            rv = virDomainObjWaitUntil(vm, now + QEMU_MIGRATION_NBD_BALANCE_INTERVAL);
+            if (rv < 0)
+                return -1;
+
+            if (!virDomainObjIsActive(vm)) {
+                virReportError(VIR_ERR_OPERATION_FAILED, "%s",
+                               _("domain is not running"));
+                return -1;
+            }
+        } else if (virDomainObjWait(vm) < 0) {
             return -1;
+        }
     }
 
     qemuMigrationSrcFetchMirrorStats(driver, vm, QEMU_ASYNC_JOB_MIGRATION_OUT,
@@ -1629,6 +1849,249 @@ qemuMigrationAnyCompleted(virQEMUDriverPtr driver,
 }
 
 
+/* How often the automatic switchover policy checks migration progress */
+#define QEMU_MIGRATION_AUTO_SWITCHOVER_INTERVAL 1000
+
+typedef struct _qemuMigrationSrcProgress qemuMigrationSrcProgress;
+typedef qemuMigrationSrcProgress *qemuMigrationSrcProgressPtr;
+struct _qemuMigrationSrcProgress {
+    virQEMUDriverConfigPtr cfg;
+    bool autoSwitchover; /* the policy may still take an action */
+    unsigned long long autoSwitchoverChecked; /* last check of the policy */
+};
+
+
+/**
+ * qemuMigrationSrcStartPostCopy:
+ * @driver: qemu driver
+ * @vm: domain object
+ * @asyncJob: async job the caller runs in or QEMU_ASYNC_JOB_NONE
+ *
+ * Switches the outgoing migration of @vm to post-copy. The migration has to
+ * be started with VIR_MIGRATE_POSTCOPY.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+qemuMigrationSrcStartPostCopy(virQEMUDriverPtr driver,
+                              virDomainObjPtr vm,
+                              qemuDomainAsyncJob asyncJob)
+{
+    qemuDomainObjPrivatePtr priv = vm->privateData;
+    int rc;
+
+    if (virDomainObjCheckActive(vm) < 0)
+        return -1;
+
+    if (priv->job.asyncJob != QEMU_ASYNC_JOB_MIGRATION_OUT) {
+        virReportError(VIR_ERR_OPERATION_INVALID, "%s",
+                       _("post-copy can only be started while "
+                         "outgoing migration is in progress"));
+        return -1;
+    }
+
+    if (!(priv->job.apiFlags & VIR_MIGRATE_POSTCOPY)) {
+        virReportError(VIR_ERR_OPERATION_INVALID, "%s",
+                       _("switching to post-copy requires migration to be "
+                         "started with VIR_MIGRATE_POSTCOPY flag"));
+        return -1;
+    }
+
+    VIR_DEBUG("Starting post-copy");
+    if (qemuDomainObjEnterMonitorAsync(driver, vm, asyncJob) < 0)
+        return -1;
+    rc = qemuMonitorMigrateStartPostCopy(priv->mon);
+    if (qemuDomainObjExitMonitor(driver, vm) < 0 || rc < 0)
+        return -1;
+
+    return 0;
+}
+
+
+/**
+ * qemuMigrationSrcAutoSwitchoverPolicy:
+ * @cfg: driver configuration
+ * @stats: current statistics of the migration
+ * @apiFlags: flags the migration was started with
+ * @action: filled in with the action to take
+ *
+ * Checks whether the memory dirty rate reached the configured ratio of the
+ * migration bandwidth after enough iterations, i.e., whether the migration
+ * is not going to converge on its own. Post-copy is preferred over raising
+ * CPU throttling, @action is set to VIR_DOMAIN_JOB_AUTO_SWITCHOVER_NONE if
+ * the flags allow neither of them.
+ *
+ * Returns true if the migration is not converging, false otherwise.
+ */
+bool
+qemuMigrationSrcAutoSwitchoverPolicy(virQEMUDriverConfigPtr cfg,
+                                     const qemuMonitorMigrationStats *stats,
+                                     unsigned long apiFlags,
+                                     virDomainJobAutoSwitchover *action)
+{
+    unsigned long long pageSize = stats->ram_page_size;
+    unsigned long long dirtyBps;
+
+    *action = VIR_DOMAIN_JOB_AUTO_SWITCHOVER_NONE;
+
+    if (cfg->migrationAutoSwitchoverRatio == 0 ||
+        stats->ram_iteration < cfg->migrationAutoSwitchoverIterations ||
+        stats->ram_bps == 0)
+        return false;
+
+    if (pageSize == 0)
+        pageSize = virGetSystemPageSize();
+
+    dirtyBps = stats->ram_dirty_rate * pageSize;
+    if (dirtyBps * 100 < stats->ram_bps * cfg->migrationAutoSwitchoverRatio)
+        return false;
+
+    if (apiFlags & VIR_MIGRATE_POSTCOPY)
+        *action = VIR_DOMAIN_JOB_AUTO_SWITCHOVER_POSTCOPY;
+    else if (apiFlags & VIR_MIGRATE_AUTO_CONVERGE &&
+             cfg->migrationAutoSwitchoverThrottle > 0)
+        *action = VIR_DOMAIN_JOB_AUTO_SWITCHOVER_THROTTLE;
+
+    return true;
+}
+
+
+/**
+ * qemuMigrationSrcAutoSwitchover:
+ *
+ * Runs the automatic switchover policy and switches the migration to
+ * post-copy or raises CPU throttling if the migration is not converging.
+ * The statistics in the current job info have to be up to date.
+ */
+static void
+qemuMigrationSrcAutoSwitchover(virQEMUDriverPtr driver,
+                               virDomainObjPtr vm,
+                               qemuDomainAsyncJob asyncJob,
+                               qemuMigrationSrcProgressPtr progress)
+{
+    qemuDomainObjPrivatePtr priv = vm->privateData;
+    qemuDomainJobInfoPtr jobInfo = priv->job.current;
+    qemuMonitorMigrationStats *stats = &jobInfo->stats.mig;
+    virQEMUDriverConfigPtr cfg = progress->cfg;
+    virDomainJobAutoSwitchover action;
+
+    if (jobInfo->status != QEMU_DOMAIN_JOB_STATUS_MIGRATING ||
+        !qemuMigrationSrcAutoSwitchoverPolicy(cfg, stats, priv->job.apiFlags,
+                                              &action))
+        return;
+
+    /* Whatever happens, we won't try again during this migration */
+    progress->autoSwitchover = false;
+
+    VIR_DEBUG("Dirty rate of domain %s exceeds %u%% of bandwidth %llu B/s",
+              vm->def->name, cfg->migrationAutoSwitchoverRatio,
+              stats->ram_bps);
+
+    switch (action) {
+    case VIR_DOMAIN_JOB_AUTO_SWITCHOVER_POSTCOPY:
+        VIR_DEBUG("Switching migration to post-copy");
+        if (qemuMigrationSrcStartPostCopy(driver, vm, asyncJob) < 0)
+            goto error;
+        break;
+
+    case VIR_DOMAIN_JOB_AUTO_SWITCHOVER_THROTTLE: {
+        g_autoptr(qemuMigrationParams) migParams = NULL;
+
+        VIR_DEBUG("Raising throttle increment to %u%%",
+                  cfg->migrationAutoSwitchoverThrottle);
+
+        if (!(migParams = qemuMigrationParamsNew()) ||
+            qemuMigrationParamsSetInt(migParams,
+                                      QEMU_MIGRATION_PARAM_THROTTLE_INCREMENT,
+                                      cfg->migrationAutoSwitchoverThrottle) < 0 ||
+            qemuMigrationParamsUpdate(driver, vm, asyncJob, migParams) < 0)
+            goto error;
+        break;
+    }
+
+    case VIR_DOMAIN_JOB_AUTO_SWITCHOVER_NONE:
+    case VIR_DOMAIN_JOB_AUTO_SWITCHOVER_LAST:
+    default:
+        VIR_DEBUG("Neither post-copy nor auto-converge can be used");
+        return;
+    }
+
+    jobInfo->autoSwitchover = action;
+    jobInfo->autoSwitchoverIteration = stats->ram_iteration;
+    return;
+
+ error:
+    VIR_WARN("Automatic switchover of migration failed for domain %s: %s",
+             vm->def->name, virGetLastErrorMessage());
+    virResetLastError();
+}
+
+
+/**
+ * qemuMigrationSrcUpdateProgress:
+ *
+ * Records a progress sample of the current job if telemetry is enabled and
+ * runs the automatic switchover policy when enough time passed since the
+ * previous run. When QEMU supports migration events, the statistics are not
+ * refreshed by qemuMigrationAnyCompleted and thus we need to fetch them here.
+ *
+ * Returns the time (in milliseconds) when this function should be called
+ * again or 0 if there is no need to wake up before the next event.
+ */
+static unsigned long long
+qemuMigrationSrcUpdateProgress(virQEMUDriverPtr driver,
+                               virDomainObjPtr vm,
+                               qemuDomainAsyncJob asyncJob,
+                               qemuMigrationSrcProgressPtr progress)
+{
+    qemuDomainObjPrivatePtr priv = vm->privateData;
+    qemuDomainJobInfoPtr jobInfo = priv->job.current;
+    qemuDomainJobTelemetryPtr telemetry = priv->job.telemetry;
+    unsigned long long autoSwitchoverNext;
+    unsigned long long next = 0;
+    unsigned long long now;
+    bool sample;
+    bool check;
+
+    if (virTimeMillisNow(&now) < 0)
+        return 0;
+
+    autoSwitchoverNext = progress->autoSwitchoverChecked +
+                         QEMU_MIGRATION_AUTO_SWITCHOVER_INTERVAL;
+    sample = qemuDomainJobTelemetryWanted(telemetry, now);
+    check = progress->autoSwitchover && now >= autoSwitchoverNext;
+
+    if ((sample || check) &&
+        virQEMUCapsGet(priv->qemuCaps, QEMU_CAPS_MIGRATION_EVENT) &&
+        qemuMigrationAnyFetchStats(driver, vm, asyncJob, jobInfo, NULL) < 0) {
+        /* try again after the next interval */
+        virResetLastError();
+        if (sample)
+            telemetry->last = now;
+        sample = check = false;
+    }
+
+    if (sample)
+        qemuDomainJobTelemetryRecord(telemetry, jobInfo, now);
+
+    if (check)
+        qemuMigrationSrcAutoSwitchover(driver, vm, asyncJob, progress);
+
+    if (check || now >= autoSwitchoverNext) {
+        progress->autoSwitchoverChecked = now;
+        autoSwitchoverNext = now + QEMU_MIGRATION_AUTO_SWITCHOVER_INTERVAL;
+    }
+
+    if (telemetry && telemetry->nsamples > 0)
+        next = telemetry->last + telemetry->interval;
+
+    if (progress->autoSwitchover && (next == 0 || autoSwitchoverNext < next))
+        next = autoSwitchoverNext;
+
+    return next;
+}
+
+
 /* Returns 0 on success, -2 when migration needs to be cancelled, or -1 when
  * QEMU reports failed migration.
  */
@@ -1641,17 +2104,40 @@ qemuMigrationSrcWaitForCompletion(virQEMUDriverPtr driver,
 {
     qemuDomainObjPrivatePtr priv = vm->privateData;
     qemuDomainJobInfoPtr jobInfo = priv->job.current;
+    g_autoptr(virQEMUDriverConfig) cfg = virQEMUDriverGetConfig(driver);
     bool events = virQEMUCapsGet(priv->qemuCaps, QEMU_CAPS_MIGRATION_EVENT);
+    qemuMigrationSrcProgress progress = { .cfg = cfg };
+    unsigned long long next;
     int rv;
 
     jobInfo->status = QEMU_DOMAIN_JOB_STATUS_MIGRATING;
 
+    progress.autoSwitchover = asyncJob == QEMU_ASYNC_JOB_MIGRATION_OUT &&
+                              cfg->migrationAutoSwitchoverRatio > 0 &&
+                              jobInfo->autoSwitchover == VIR_DOMAIN_JOB_AUTO_SWITCHOVER_NONE;
+
     while ((rv = qemuMigrationAnyCompleted(driver, vm, asyncJob,
                                            dconn, flags)) != 1) {
         if (rv < 0)
             return rv;
 
-        if (events) {
+        next = qemuMigrationSrcUpdateProgress(driver, vm, asyncJob, &progress);
+
+        if (events && next > 0) {
+            /* Wake up periodically to record progress even if QEMU does not
+             * send any event. */
+            if (virDomainObjWaitUntil(vm, next) < 0) {
+                if (virDomainObjIsActive(vm))
+                    jobInfo->status = QEMU_DOMAIN_JOB_STATUS_FAILED;
+                return -2;
+            }
+
+            if (!virDomainObjIsActive(vm)) {
+                virReportError(VIR_ERR_OPERATION_FAILED, "%s",
+                               _("domain is not running"));
+                return -2;
+            }
+        } else if (events) {
             if (virDomainObjWait(vm) < 0) {
                 if (virDomainObjIsActive(vm))
                     jobInfo->status = QEMU_DOMAIN_JOB_STATUS_FAILED;
@@ -3120,7 +3606,12 @@ struct _qemuMigrationSpec {
     } fwd;
 };
 
-#define TUNNEL_SEND_BUF_SIZE 65536
+/* Send the largest chunks all peers are able to receive in a single stream
+ * message to minimize per-message overhead. */
+#define TUNNEL_SEND_BUF_SIZE VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX
+
+/* Size of the pipe between QEMU and the tunnel thread */
+#define TUNNEL_PIPE_SIZE (1024 * 1024)
 
 typedef struct _qemuMigrationIOThread qemuMigrationIOThread;
 typedef qemuMigrationIOThread *qemuMigrationIOThreadPtr;
@@ -3131,6 +3622,10 @@ struct _qemuMigrationIOThread {
     virError err;
     int wakeupRecvFD;
     int wakeupSendFD;
+    /* written by the IO thread, valid once it was joined */
+    unsigned long long transferred;
+    unsigned long long started;
+    unsigned long long finished;
 };
 
 static void qemuMigrationSrcIOFunc(void *arg)
@@ -3147,6 +3642,8 @@ static void qemuMigrationSrcIOFunc(void *arg)
     if (VIR_ALLOC_N(buffer, TUNNEL_SEND_BUF_SIZE) < 0)
         goto abrt;
 
+    ignore_value(virTimeMillisNow(&data->started));
+
     fds[0].fd = data->sock;
     fds[1].fd = data->wakeupRecvFD;
 
@@ -3200,6 +3697,7 @@ static void qemuMigrationSrcIOFunc(void *arg)
             if (nbytes > 0) {
                 if (virStreamSend(data->st, buffer, nbytes) < 0)
                     goto error;
+                data->transferred += nbytes;
             } else if (nbytes < 0) {
                 virReportSystemError(errno, "%s",
                         _("tunnelled migration failed to read from qemu"));
@@ -3214,6 +3712,8 @@ static void qemuMigrationSrcIOFunc(void *arg)
     if (virStreamFinish(data->st) < 0)
         goto error;
 
+    ignore_value(virTimeMillisNow(&data->finished));
+
     VIR_FORCE_CLOSE(data->sock);
     VIR_FREE(buffer);
 
@@ -3277,8 +3777,20 @@ qemuMigrationSrcStartTunnel(virStreamPtr st,
     return NULL;
 }
 
+/**
+ * qemuMigrationSrcStopTunnel:
+ * @io: tunnel thread data
+ * @error: whether the tunnel should be aborted
+ * @jobInfo: job info to store tunnel statistics in (may be NULL)
+ *
+ * Stops the tunnel thread and frees @io.
+ *
+ * Returns 0 on success, -1 on error.
+ */
 static int
-qemuMigrationSrcStopTunnel(qemuMigrationIOThreadPtr io, bool error)
+qemuMigrationSrcStopTunnel(qemuMigrationIOThreadPtr io,
+                           bool error,
+                           qemuDomainJobInfoPtr jobInfo)
 {
     int rv = -1;
     char stop = error ? 1 : 0;
@@ -3302,6 +3814,14 @@ qemuMigrationSrcStopTunnel(qemuMigrationIOThreadPtr io, bool error)
         goto cleanup;
     }
 
+    if (jobInfo && io->finished > io->started) {
+        jobInfo->tunnelBps = io->transferred * 1000 /
+                             (io->finished - io->started);
+        VIR_DEBUG("Tunnel transferred %llu bytes in %llu ms (%llu B/s)",
+                  io->transferred, io->finished - io->started,
+                  jobInfo->tunnelBps);
+    }
+
     rv = 0;
 
  cleanup:
@@ -3675,7 +4195,7 @@ qemuMigrationSrcRun(virQEMUDriverPtr driver,
         qemuMigrationIOThreadPtr io;
 
         io = g_steal_pointer(&iothread);
-        if (qemuMigrationSrcStopTunnel(io, false) < 0)
+        if (qemuMigrationSrcStopTunnel(io, false, priv->job.completed) < 0)
             goto error;
     }
 
@@ -3734,7 +4254,7 @@ qemuMigrationSrcRun(virQEMUDriverPtr driver,
     }
 
     if (iothread)
-        qemuMigrationSrcStopTunnel(iothread, true);
+        qemuMigrationSrcStopTunnel(iothread, true, NULL);
 
     goto cleanup;
 
@@ -3867,6 +4387,13 @@ qemuMigrationSrcPerformTunnel(virQEMUDriverPtr driver,
     if (pipe2(fds, O_CLOEXEC) == 0) {
         spec.dest.fd.qemu = fds[1];
         spec.dest.fd.local = fds[0];
+#ifdef F_SETPIPE_SZ
+        /* Let QEMU write ahead while the tunnel thread is busy sending the
+         * previous chunk. The default pipe size is just 64 KiB. */
+        if (fcntl(fds[0], F_SETPIPE_SZ, TUNNEL_PIPE_SIZE) < 0)
+            VIR_DEBUG("Failed to enlarge migration pipe: %s",
+                      g_strerror(errno));
+#endif
     }
     if (spec.dest.fd.qemu == -1 ||
         qemuSecuritySetImageFDLabel(driver->securityManager, vm->def,
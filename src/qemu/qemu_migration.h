@@ -213,6 +213,11 @@ int
 qemuMigrationSrcCancel(virQEMUDriverPtr driver,
                        virDomainObjPtr vm);
 
+int
+qemuMigrationSrcStartPostCopy(virQEMUDriverPtr driver,
+                              virDomainObjPtr vm,
+                              qemuDomainAsyncJob asyncJob);
+
 int
 qemuMigrationAnyFetchStats(virQEMUDriverPtr driver,
                            virDomainObjPtr vm,
@@ -910,6 +910,51 @@ qemuMigrationParamsApply(virQEMUDriverPtr driver,
 }
 
 
+/**
+ * qemuMigrationParamsUpdate:
+ * @driver: qemu driver
+ * @vm: domain object
+ * @asyncJob: migration job
+ * @migParams: migration parameters to set
+ *
+ * Unlike qemuMigrationParamsApply this function ignores migration
+ * capabilities and only sets the parameters enabled in @migParams. Thus it
+ * can be used to tune a migration which is already running.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+qemuMigrationParamsUpdate(virQEMUDriverPtr driver,
+                          virDomainObjPtr vm,
+                          int asyncJob,
+                          qemuMigrationParamsPtr migParams)
+{
+    qemuDomainObjPrivatePtr priv = vm->privateData;
+    virJSONValuePtr params = NULL;
+    int rc;
+
+    if (!(params = qemuMigrationParamsToJSON(migParams)))
+        return -1;
+
+    if (virJSONValueObjectKeysNumber(params) == 0) {
+        virJSONValueFree(params);
+        return 0;
+    }
+
+    if (qemuDomainObjEnterMonitorAsync(driver, vm, asyncJob) < 0) {
+        virJSONValueFree(params);
+        return -1;
+    }
+
+    rc = qemuMonitorSetMigrationParams(priv->mon, params);
+
+    if (qemuDomainObjExitMonitor(driver, vm) < 0 || rc < 0)
+        return -1;
+
+    return 0;
+}
+
+
 /**
  * qemuMigrationParamsSetString:
  * @migrParams: migration parameter object
@@ -1130,6 +1175,20 @@ qemuMigrationParamsFetch(virQEMUDriverPtr driver,
 }
 
 
+int
+qemuMigrationParamsSetInt(qemuMigrationParamsPtr migParams,
+                          qemuMigrationParam param,
+                          int value)
+{
+    if (qemuMigrationParamsCheckType(param, QEMU_MIGRATION_PARAM_TYPE_INT) < 0)
+        return -1;
+
+    migParams->params[param].value.i = value;
+    migParams->params[param].set = true;
+    return 0;
+}
+
+
 int
 qemuMigrationParamsSetULL(qemuMigrationParamsPtr migParams,
                           qemuMigrationParam param,
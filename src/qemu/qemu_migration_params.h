@@ -100,6 +100,12 @@ qemuMigrationParamsApply(virQEMUDriverPtr driver,
                          int asyncJob,
                          qemuMigrationParamsPtr migParams);
 
+int
+qemuMigrationParamsUpdate(virQEMUDriverPtr driver,
+                          virDomainObjPtr vm,
+                          int asyncJob,
+                          qemuMigrationParamsPtr migParams);
+
 int
 qemuMigrationParamsEnableTLS(virQEMUDriverPtr driver,
                              virDomainObjPtr vm,
@@ -119,6 +125,11 @@ qemuMigrationParamsFetch(virQEMUDriverPtr driver,
                          int asyncJob,
                          qemuMigrationParamsPtr *migParams);
 
+int
+qemuMigrationParamsSetInt(qemuMigrationParamsPtr migParams,
+                          qemuMigrationParam param,
+                          int value);
+
 int
 qemuMigrationParamsSetULL(qemuMigrationParamsPtr migParams,
                           qemuMigrationParam param,
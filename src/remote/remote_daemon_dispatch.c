@@ -5502,7 +5502,7 @@ remoteDispatchDomainGetJobStats(virNetServerPtr server G_GNUC_UNUSED,
         goto cleanup;
 
     if (virTypedParamsSerialize(params, nparams,
-                                REMOTE_DOMAIN_JOB_STATS_MAX,
+                                REMOTE_DOMAIN_GET_JOB_STATS_MAX,
                                 (virTypedParameterRemotePtr *) &ret->params.params_val,
                                 &ret->params.params_len,
                                 0) < 0)
@@ -7044,7 +7044,7 @@ remoteDomainGetJobStats(virDomainPtr domain,
 
     if (virTypedParamsDeserialize((virTypedParameterRemotePtr) ret.params.params_val,
                                   ret.params.params_len,
-                                  REMOTE_DOMAIN_JOB_STATS_MAX,
+                                  REMOTE_DOMAIN_GET_JOB_STATS_MAX,
                                   params, nparams) < 0)
         goto cleanup;
 
@@ -233,6 +233,11 @@ const REMOTE_DOMAIN_MIGRATE_PARAM_LIST_MAX = 64;
 /* Upper limit on number of job stats */
 const REMOTE_DOMAIN_JOB_STATS_MAX = 64;
 
+/* Upper limit on number of job stats returned by virDomainGetJobStats,
+ * which includes up to 1024 fields of VIR_DOMAIN_JOB_STATS_TELEMETRY
+ * history on top of REMOTE_DOMAIN_JOB_STATS_MAX regular ones */
+const REMOTE_DOMAIN_GET_JOB_STATS_MAX = 1088;
+
 /* Upper limit on number of CPU models */
 const REMOTE_CONNECT_CPU_MODELS_MAX = 8192;
 
@@ -2385,7 +2390,7 @@ struct remote_domain_get_job_stats_args {
 
 struct remote_domain_get_job_stats_ret {
     int type;
-    remote_typed_param params<REMOTE_DOMAIN_JOB_STATS_MAX>;
+    remote_typed_param params<REMOTE_DOMAIN_GET_JOB_STATS_MAX>;
 };
 
 
@@ -32,6 +32,10 @@ typedef int (*virStorageBackendStartPool)(virStoragePoolObjPtr pool);
 typedef int (*virStorageBackendBuildPool)(virStoragePoolObjPtr pool,
                                           unsigned int flags);
 typedef int (*virStorageBackendRefreshPool)(virStoragePoolObjPtr pool);
+typedef int (*virStorageBackendGetPoolSize)(const char *target,
+                                            unsigned long long *capacity,
+                                            unsigned long long *allocation,
+                                            unsigned long long *available);
 typedef int (*virStorageBackendStopPool)(virStoragePoolObjPtr pool);
 typedef int (*virStorageBackendDeletePool)(virStoragePoolObjPtr pool,
                                            unsigned int flags);
@@ -105,6 +109,13 @@ struct _virStorageBackend {
     virStorageBackendStartPool startPool;
     virStorageBackendBuildPool buildPool;
     virStorageBackendRefreshPool refreshPool; /* Must be non-NULL */
+    /* refreshPool updates the existing volumes of the pool itself
+     * rather than expecting the volume list to be cleared first */
+    bool refreshIncremental;
+    /* Cheaply gets just the capacity, allocation and available values
+     * of a running pool from its target without looking at its volumes.
+     * Called without the pool object locked. */
+    virStorageBackendGetPoolSize getPoolSize;
     virStorageBackendStopPool stopPool;
     virStorageBackendDeletePool deletePool;
 
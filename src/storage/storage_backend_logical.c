@@ -36,6 +36,9 @@
 #include "virstring.h"
 #include "storage_util.h"
 
+#define LIBVIRT_STORAGE_BACKEND_LOGICAL_PRIV_H_ALLOW
+#include "storage_backend_logical_priv.h"
+
 #define VIR_FROM_THIS VIR_FROM_STORAGE
 
 VIR_LOG_INIT("storage.storage_backend_logical");
@@ -114,6 +117,11 @@ virStorageBackendLogicalInitializeDevice(const char *path)
 struct virStorageBackendLogicalPoolVolData {
     virStoragePoolObjPtr pool;
     virStorageVolDefPtr vol;
+
+    /* Size of the volume group, as reported along with each LV */
+    bool haveVGSize;
+    unsigned long long vgSize;
+    unsigned long long vgFree;
 };
 
 static int
@@ -229,6 +237,16 @@ virStorageBackendLogicalMakeVol(char **const groups,
     int ret = -1;
     const char *attrs = groups[9];
 
+    if (!data->haveVGSize) {
+        if (virStrToLong_ull(groups[10], NULL, 10, &data->vgSize) < 0 ||
+            virStrToLong_ull(groups[11], NULL, 10, &data->vgFree) < 0) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           "%s", _("malformed volume group size value"));
+            return -1;
+        }
+        data->haveVGSize = true;
+    }
+
     /* Skip inactive volume */
     if (attrs[4] != 'a')
         return 0;
@@ -333,9 +351,11 @@ virStorageBackendLogicalMakeVol(char **const groups,
 #define VIR_STORAGE_VOL_LOGICAL_VG_EXTENT_SIZE_REGEX "([0-9]+)#"
 #define VIR_STORAGE_VOL_LOGICAL_SIZE_REGEX "([0-9]+)#"
 #define VIR_STORAGE_VOL_LOGICAL_LV_ATTR_REGEX "(\\S+)#"
+#define VIR_STORAGE_VOL_LOGICAL_VG_SIZE_REGEX "([0-9]+)#"
+#define VIR_STORAGE_VOL_LOGICAL_VG_FREE_REGEX "([0-9]+)#"
 #define VIR_STORAGE_VOL_LOGICAL_SUFFIX_REGEX "?\\s*$"
 
-#define VIR_STORAGE_VOL_LOGICAL_REGEX_COUNT 10
+#define VIR_STORAGE_VOL_LOGICAL_REGEX_COUNT 12
 #define VIR_STORAGE_VOL_LOGICAL_REGEX \
            VIR_STORAGE_VOL_LOGICAL_PREFIX_REGEX \
            VIR_STORAGE_VOL_LOGICAL_LV_NAME_REGEX \
@@ -348,25 +368,33 @@ virStorageBackendLogicalMakeVol(char **const groups,
            VIR_STORAGE_VOL_LOGICAL_VG_EXTENT_SIZE_REGEX \
            VIR_STORAGE_VOL_LOGICAL_SIZE_REGEX \
            VIR_STORAGE_VOL_LOGICAL_LV_ATTR_REGEX \
+           VIR_STORAGE_VOL_LOGICAL_VG_SIZE_REGEX \
+           VIR_STORAGE_VOL_LOGICAL_VG_FREE_REGEX \
            VIR_STORAGE_VOL_LOGICAL_SUFFIX_REGEX
 
+/*
+ * Lists the LVs of the volume group backing @pool and adds them to it. If
+ * @vol is given, only that LV is queried and its definition filled in. The
+ * size of the volume group is stored in @data, if the group has any LVs.
+ */
 static int
 virStorageBackendLogicalFindLVs(virStoragePoolObjPtr pool,
-                                virStorageVolDefPtr vol)
+                                virStorageVolDefPtr vol,
+                                struct virStorageBackendLogicalPoolVolData *data)
 {
     /*
      * # lvs --separator # --noheadings --units b --unbuffered --nosuffix --options \
-     * "lv_name,origin,uuid,devices,segtype,stripes,seg_size,vg_extent_size,size,lv_attr" VGNAME
+     * "lv_name,origin,uuid,devices,segtype,stripes,seg_size,vg_extent_size,size,lv_attr,vg_size,vg_free" VGNAME
      *
-     * RootLV##06UgP5-2rhb-w3Bo-3mdR-WeoL-pytO-SAa2ky#/dev/hda2(0)#linear#1#5234491392#33554432#5234491392#-wi-ao
-     * SwapLV##oHviCK-8Ik0-paqS-V20c-nkhY-Bm1e-zgzU0M#/dev/hda2(156)#linear#1#1040187392#33554432#1040187392#-wi-ao
-     * Test2##3pg3he-mQsA-5Sui-h0i6-HNmc-Cz7W-QSndcR#/dev/hda2(219)#linear#1#1073741824#33554432#1073741824#owi-a-
-     * Test3##UB5hFw-kmlm-LSoX-EI1t-ioVd-h7GL-M0W8Ht#/dev/hda2(251)#linear#1#2181038080#33554432#2181038080#-wi-a-
-     * Test3#Test2#UB5hFw-kmlm-LSoX-EI1t-ioVd-h7GL-M0W8Ht#/dev/hda2(187)#linear#1#1040187392#33554432#1040187392#swi-a-
-     * test_stripes##fSLSZH-zAS2-yAIb-n4mV-Al9u-HA3V-oo9K1B#/dev/sdc1(10240),/dev/sdd1(0)#striped#2#42949672960#4194304#-wi-a-
+     * RootLV##06UgP5-2rhb-w3Bo-3mdR-WeoL-pytO-SAa2ky#/dev/hda2(0)#linear#1#5234491392#33554432#5234491392#-wi-ao#10603200512#4328521728
+     * SwapLV##oHviCK-8Ik0-paqS-V20c-nkhY-Bm1e-zgzU0M#/dev/hda2(156)#linear#1#1040187392#33554432#1040187392#-wi-ao#10603200512#4328521728
+     * Test2##3pg3he-mQsA-5Sui-h0i6-HNmc-Cz7W-QSndcR#/dev/hda2(219)#linear#1#1073741824#33554432#1073741824#owi-a-#10603200512#4328521728
+     * Test3##UB5hFw-kmlm-LSoX-EI1t-ioVd-h7GL-M0W8Ht#/dev/hda2(251)#linear#1#2181038080#33554432#2181038080#-wi-a-#10603200512#4328521728
+     * Test3#Test2#UB5hFw-kmlm-LSoX-EI1t-ioVd-h7GL-M0W8Ht#/dev/hda2(187)#linear#1#1040187392#33554432#1040187392#swi-a-#10603200512#4328521728
+     * test_stripes##fSLSZH-zAS2-yAIb-n4mV-Al9u-HA3V-oo9K1B#/dev/sdc1(10240),/dev/sdd1(0)#striped#2#42949672960#4194304#-wi-a-#10603200512#4328521728
      *
      * Pull out name, origin, & uuid, device, device extent start #,
-     * segment size, extent size, size, attrs
+     * segment size, extent size, size, attrs, VG size and free space
      *
      * NB can be multiple rows per volume if they have many extents
      *
@@ -386,12 +414,20 @@ virStorageBackendLogicalFindLVs(virStoragePoolObjPtr pool,
         VIR_STORAGE_VOL_LOGICAL_REGEX_COUNT
     };
     virStoragePoolDefPtr def = virStoragePoolObjGetDef(pool);
-    struct virStorageBackendLogicalPoolVolData cbdata = {
-        .pool = pool,
-        .vol = vol,
-    };
+    g_autofree char *target = NULL;
     g_autoptr(virCommand) cmd = NULL;
 
+    data->pool = pool;
+    data->vol = vol;
+    data->haveVGSize = false;
+
+    /* Listing just the volume we are interested in is way cheaper than
+     * reporting on the whole group, which might have hundreds of LVs. */
+    if (vol)
+        target = g_strdup_printf("%s/%s", def->source.name, vol->name);
+    else
+        target = g_strdup(def->source.name);
+
     cmd = virCommandNewArgList(LVS,
                                "--separator", "#",
                                "--noheadings",
@@ -399,12 +435,12 @@ virStorageBackendLogicalFindLVs(virStoragePoolObjPtr pool,
                                "--unbuffered",
                                "--nosuffix",
                                "--options",
-                               "lv_name,origin,uuid,devices,segtype,stripes,seg_size,vg_extent_size,size,lv_attr",
-                               def->source.name,
+                               "lv_name,origin,uuid,devices,segtype,stripes,seg_size,vg_extent_size,size,lv_attr,vg_size,vg_free",
+                               target,
                                NULL);
     return virCommandRunRegex(cmd, 1, regexes, vars,
                               virStorageBackendLogicalMakeVol,
-                              &cbdata, "lvs", NULL);
+                              data, "lvs", NULL);
 }
 
 static int
@@ -715,7 +751,7 @@ virStorageBackendLogicalBuildPool(virStoragePoolObjPtr pool,
 }
 
 
-static int
+int
 virStorageBackendLogicalRefreshPool(virStoragePoolObjPtr pool)
 {
     /*
@@ -733,14 +769,24 @@ virStorageBackendLogicalRefreshPool(virStoragePoolObjPtr pool)
         2
     };
     virStoragePoolDefPtr def = virStoragePoolObjGetDef(pool);
+    struct virStorageBackendLogicalPoolVolData cbdata = { 0 };
     g_autoptr(virCommand) cmd = NULL;
 
     virWaitForDevices();
 
     /* Get list of all logical volumes */
-    if (virStorageBackendLogicalFindLVs(pool, NULL) < 0)
+    if (virStorageBackendLogicalFindLVs(pool, NULL, &cbdata) < 0)
         return -1;
 
+    /* The LV report carries the VG size too, so another LVM invocation
+     * is needed only if the group has no LVs at all. */
+    if (cbdata.haveVGSize) {
+        def->capacity = cbdata.vgSize;
+        def->available = cbdata.vgFree;
+        def->allocation = def->capacity - def->available;
+        return 0;
+    }
+
     cmd = virCommandNewArgList(VGS,
                                "--separator", ":",
                                "--noheadings",
@@ -879,6 +925,7 @@ virStorageBackendLogicalCreateVol(virStoragePoolObjPtr pool,
                                   virStorageVolDefPtr vol)
 {
     virStoragePoolDefPtr def = virStoragePoolObjGetDef(pool);
+    struct virStorageBackendLogicalPoolVolData cbdata = { 0 };
     virErrorPtr err;
     struct stat sb;
     VIR_AUTOCLOSE fd = -1;
@@ -925,7 +972,7 @@ virStorageBackendLogicalCreateVol(virStoragePoolObjPtr pool,
     }
 
     /* Fill in data about this new vol */
-    if (virStorageBackendLogicalFindLVs(pool, vol) < 0) {
+    if (virStorageBackendLogicalFindLVs(pool, vol, &cbdata) < 0) {
         virReportSystemError(errno,
                              _("cannot find newly created volume '%s'"),
                              vol->target.path);
@@ -31,6 +31,8 @@
 #include "viruuid.h"
 #include "virstring.h"
 #include "virrandom.h"
+#include "virfdstream.h"
+#include "virfile.h"
 #include "rados/librados.h"
 #include "rbd/librbd.h"
 #include "secret_util.h"
@@ -1313,66 +1315,163 @@ virStorageBackendRBDResizeVol(virStoragePoolObjPtr pool,
     return ret;
 }
 
-static int
-virStorageBackendRBDVolWipeZero(rbd_image_t image,
-                                char *imgname,
-                                rbd_image_info_t *info,
-                                uint64_t stripe_count)
+/* Number of requests kept in flight while wiping or copying data of a
+ * volume, unless set by the rbd_concurrent_management_ops option which
+ * 'rbd import' and 'rbd export' use for the same purpose. A single
+ * synchronous request covers just one stripe set, i.e. a handful of OSDs,
+ * so issuing more of them at once lets the whole cluster do the work. */
+#define VIR_STORAGE_RBD_QUEUE_DEPTH 16
+
+/* Upper limit of the configured queue depth, each request of an upload or
+ * download holds a buffer of the size of an RBD object */
+#define VIR_STORAGE_RBD_QUEUE_DEPTH_MAX 64
+
+static size_t
+virStorageBackendRBDQueueDepth(virStorageBackendRBDStatePtr ptr)
 {
-    unsigned long long offset = 0;
-    unsigned long long length;
-    g_autofree char *writebuf = NULL;
+    char buf[32];
+    unsigned int depth;
 
-    if (VIR_ALLOC_N(writebuf, info->obj_size * stripe_count) < 0)
-        return -1;
+    if (rados_conf_get(ptr->cluster, "rbd_concurrent_management_ops",
+                       buf, sizeof(buf)) < 0 ||
+        virStrToLong_ui(buf, NULL, 10, &depth) < 0 ||
+        depth == 0)
+        return VIR_STORAGE_RBD_QUEUE_DEPTH;
 
-    while (offset < info->size) {
-        length = MIN((info->size - offset), (info->obj_size * stripe_count));
+    return MIN(depth, VIR_STORAGE_RBD_QUEUE_DEPTH_MAX);
+}
 
-        if (rbd_write(image, offset, length, writebuf) < 0) {
-            virReportSystemError(errno, _("writing %llu bytes failed on "
-                                       "RBD image %s at offset %llu"),
-                                       length, imgname, offset);
-            return -1;
-        }
+/* Waits for the request of @comp, if any, and releases it. Returns the
+ * result of the request. */
+static ssize_t
+virStorageBackendRBDAioWait(rbd_completion_t *comp)
+{
+    ssize_t rc;
 
-        VIR_DEBUG("Wrote %llu bytes to RBD image %s at offset %llu",
-                  length, imgname, offset);
+    if (!*comp)
+        return 0;
 
-        offset += length;
+    rbd_aio_wait_for_complete(*comp);
+    rc = rbd_aio_get_return_value(*comp);
+    rbd_aio_release(*comp);
+    *comp = NULL;
+
+    return rc;
+}
+
+static int
+virStorageBackendRBDVolWipeAioWait(rbd_completion_t *comp,
+                                   const char *imgname,
+                                   bool discard)
+{
+    ssize_t rc;
+
+    if ((rc = virStorageBackendRBDAioWait(comp)) < 0) {
+        if (discard)
+            virReportSystemError(-rc, _("discarding failed on RBD image %s"),
+                                 imgname);
+        else
+            virReportSystemError(-rc, _("writing failed on RBD image %s"),
+                                 imgname);
+        errno = -rc;
+        return -1;
     }
 
     return 0;
 }
 
 static int
-virStorageBackendRBDVolWipeDiscard(rbd_image_t image,
-                                   char *imgname,
-                                   rbd_image_info_t *info,
-                                   uint64_t stripe_count)
+virStorageBackendRBDVolWipeAio(rbd_image_t image,
+                               char *imgname,
+                               rbd_image_info_t *info,
+                               uint64_t stripe_count,
+                               size_t depth,
+                               bool discard)
 {
+    g_autofree rbd_completion_t *comps = g_new0(rbd_completion_t, depth);
     unsigned long long offset = 0;
     unsigned long long length;
+    unsigned long long chunk = info->obj_size * stripe_count;
+    g_autofree char *writebuf = NULL;
+    size_t i = 0;
+    size_t j;
+    int ret = -1;
 
-    VIR_DEBUG("Wiping RBD %s volume using discard)", imgname);
+    VIR_DEBUG("Wiping RBD %s volume using %s", imgname,
+              discard ? "discard" : "zeroes");
+
+    /* All the requests in flight share the same zeroed buffer, it's never
+     * modified */
+    if (!discard &&
+        VIR_ALLOC_N(writebuf, chunk) < 0)
+        return -1;
 
     while (offset < info->size) {
-        length = MIN((info->size - offset), (info->obj_size * stripe_count));
+        rbd_completion_t *comp = &comps[i++ % depth];
+        int rc;
+
+        /* Wait for the oldest request to free up its slot */
+        if (virStorageBackendRBDVolWipeAioWait(comp, imgname, discard) < 0)
+            goto cleanup;
+
+        length = MIN((info->size - offset), chunk);
 
-        if (rbd_discard(image, offset, length) < 0) {
-            virReportSystemError(errno, _("discarding %llu bytes failed on "
-                                       "RBD image %s at offset %llu"),
+        if ((rc = rbd_aio_create_completion(NULL, NULL, comp)) < 0) {
+            virReportSystemError(-rc, "%s",
+                                 _("failed to create RBD completion"));
+            *comp = NULL;
+            errno = -rc;
+            goto cleanup;
+        }
+
+        if (discard)
+            rc = rbd_aio_discard(image, offset, length, *comp);
+        else
+            rc = rbd_aio_write(image, offset, length, writebuf, *comp);
+
+        if (rc < 0) {
+            if (discard)
+                virReportSystemError(-rc, _("discarding %llu bytes failed on "
+                                            "RBD image %s at offset %llu"),
                                      length, imgname, offset);
-            return -1;
+            else
+                virReportSystemError(-rc, _("writing %llu bytes failed on "
+                                            "RBD image %s at offset %llu"),
+                                     length, imgname, offset);
+            rbd_aio_release(*comp);
+            *comp = NULL;
+            errno = -rc;
+            goto cleanup;
         }
 
-        VIR_DEBUG("Discarded %llu bytes of RBD image %s at offset %llu",
-                  length, imgname, offset);
+        VIR_DEBUG("Queued %s of %llu bytes of RBD image %s at offset %llu",
+                  discard ? "discard" : "write", length, imgname, offset);
 
         offset += length;
     }
 
-    return 0;
+    ret = 0;
+
+ cleanup:
+    /* Requests in flight must finish even on failure, they reference
+     * both @image and @writebuf */
+    for (j = 0; j < depth; j++) {
+        if (ret < 0) {
+            virErrorPtr err;
+            int save_errno = errno;
+
+            virErrorPreserveLast(&err);
+            ignore_value(virStorageBackendRBDVolWipeAioWait(&comps[j], imgname,
+                                                            discard));
+            virErrorRestore(&err);
+            errno = save_errno;
+        } else if (virStorageBackendRBDVolWipeAioWait(&comps[j], imgname,
+                                                      discard) < 0) {
+            ret = -1;
+        }
+    }
+
+    return ret;
 }
 
 static int
@@ -1386,6 +1485,7 @@ virStorageBackendRBDVolWipe(virStoragePoolObjPtr pool,
     rbd_image_t image = NULL;
     rbd_image_info_t info;
     uint64_t stripe_count;
+    size_t depth;
     int rc = 0;
     int ret = -1;
 
@@ -1421,14 +1521,16 @@ virStorageBackendRBDVolWipe(virStoragePoolObjPtr pool,
     VIR_DEBUG("Need to wipe %"PRIu64" bytes from RBD image %s/%s",
               info.size, def->source.name, vol->name);
 
+    depth = virStorageBackendRBDQueueDepth(ptr);
+
     switch ((virStorageVolWipeAlgorithm) algorithm) {
     case VIR_STORAGE_VOL_WIPE_ALG_ZERO:
-        rc = virStorageBackendRBDVolWipeZero(image, vol->name,
-                                            &info, stripe_count);
-            break;
+        rc = virStorageBackendRBDVolWipeAio(image, vol->name, &info,
+                                            stripe_count, depth, false);
+        break;
     case VIR_STORAGE_VOL_WIPE_ALG_TRIM:
-        rc = virStorageBackendRBDVolWipeDiscard(image, vol->name,
-                                               &info, stripe_count);
+        rc = virStorageBackendRBDVolWipeAio(image, vol->name, &info,
+                                            stripe_count, depth, true);
         break;
     case VIR_STORAGE_VOL_WIPE_ALG_NNSA:
     case VIR_STORAGE_VOL_WIPE_ALG_DOD:
@@ -1462,6 +1564,385 @@ virStorageBackendRBDVolWipe(virStoragePoolObjPtr pool,
 }
 
 
+/* State of a volume upload or download. The data is passed between the
+ * stream and the RBD image through a pipe by a thread which keeps up to
+ * @depth requests of @chunk bytes in flight. */
+typedef struct _virStorageBackendRBDStream virStorageBackendRBDStream;
+typedef virStorageBackendRBDStream *virStorageBackendRBDStreamPtr;
+struct _virStorageBackendRBDStream {
+    virStorageBackendRBDStatePtr ptr;
+    rbd_image_t image;
+    char *imgname;
+    bool upload;
+    int fd; /* our end of the pipe, the stream has the other one */
+    unsigned long long offset; /* where the data starts in the image */
+    unsigned long long end; /* and where it ends */
+    size_t chunk;
+    size_t depth;
+    virThread thread;
+    virErrorPtr err; /* error of the thread */
+};
+
+static void
+virStorageBackendRBDStreamFree(void *opaque)
+{
+    virStorageBackendRBDStreamPtr data = opaque;
+
+    if (!data)
+        return;
+
+    VIR_FORCE_CLOSE(data->fd);
+    if (data->image)
+        rbd_close(data->image);
+    virStorageBackendRBDFreeState(&data->ptr);
+    virFreeError(data->err);
+    g_free(data->imgname);
+    g_free(data);
+}
+
+static int
+virStorageBackendRBDStreamWait(virStorageBackendRBDStreamPtr data,
+                               rbd_completion_t *comp)
+{
+    ssize_t rc;
+
+    if ((rc = virStorageBackendRBDAioWait(comp)) < 0) {
+        if (data->upload)
+            virReportSystemError(-rc, _("writing failed on RBD image %s"),
+                                 data->imgname);
+        else
+            virReportSystemError(-rc, _("reading failed on RBD image %s"),
+                                 data->imgname);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int
+virStorageBackendRBDStreamSubmit(virStorageBackendRBDStreamPtr data,
+                                 rbd_completion_t *comp,
+                                 unsigned long long offset,
+                                 size_t length,
+                                 char *buf)
+{
+    int rc;
+
+    if ((rc = rbd_aio_create_completion(NULL, NULL, comp)) < 0) {
+        virReportSystemError(-rc, "%s", _("failed to create RBD completion"));
+        *comp = NULL;
+        return -1;
+    }
+
+    if (data->upload)
+        rc = rbd_aio_write(data->image, offset, length, buf, *comp);
+    else
+        rc = rbd_aio_read(data->image, offset, length, buf, *comp);
+
+    if (rc < 0) {
+        if (data->upload)
+            virReportSystemError(-rc, _("writing %zu bytes failed on "
+                                        "RBD image %s at offset %llu"),
+                                 length, data->imgname, offset);
+        else
+            virReportSystemError(-rc, _("reading %zu bytes failed on "
+                                        "RBD image %s at offset %llu"),
+                                 length, data->imgname, offset);
+        rbd_aio_release(*comp);
+        *comp = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Reads the data from the stream and writes it to the image in chunks,
+ * queueing the next write as soon as its data is there. */
+static int
+virStorageBackendRBDStreamUpload(virStorageBackendRBDStreamPtr data,
+                                 rbd_completion_t *comps,
+                                 char **bufs)
+{
+    unsigned long long offset = data->offset;
+    size_t i;
+    int rc;
+
+    for (i = 0; ; i++) {
+        size_t slot = i % data->depth;
+        size_t length = MIN(data->chunk, data->end - offset);
+        ssize_t got;
+
+        /* Wait for the oldest write to free up its buffer */
+        if (virStorageBackendRBDStreamWait(data, &comps[slot]) < 0)
+            return -1;
+
+        /* Read one more byte at the end to find out if there's more
+         * data than fits */
+        if ((got = saferead(data->fd, bufs[slot], MAX(length, 1))) < 0) {
+            virReportSystemError(errno, _("unable to read data for RBD image %s"),
+                                 data->imgname);
+            return -1;
+        }
+
+        if (got == 0)
+            break;
+
+        if (length == 0) {
+            virReportSystemError(ENOSPC,
+                                 _("data exceeds the capacity of RBD image %s"),
+                                 data->imgname);
+            return -1;
+        }
+
+        if (virStorageBackendRBDStreamSubmit(data, &comps[slot], offset,
+                                             got, bufs[slot]) < 0)
+            return -1;
+
+        offset += got;
+    }
+
+    for (i = 0; i < data->depth; i++) {
+        if (virStorageBackendRBDStreamWait(data, &comps[i]) < 0)
+            return -1;
+    }
+
+    if ((rc = rbd_flush(data->image)) < 0) {
+        virReportSystemError(-rc, _("failed to flush RBD image %s"),
+                             data->imgname);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Reads the image in chunks, keeping the reads of the following chunks in
+ * flight while the data of the oldest one is written to the stream. */
+static int
+virStorageBackendRBDStreamDownload(virStorageBackendRBDStreamPtr data,
+                                   rbd_completion_t *comps,
+                                   char **bufs)
+{
+    g_autofree size_t *lengths = g_new0(size_t, data->depth);
+    unsigned long long offset = data->offset;
+    size_t inflight = 0;
+    size_t i;
+
+    for (i = 0; offset < data->end || inflight > 0; i++) {
+        size_t slot = i % data->depth;
+
+        if (comps[slot]) {
+            if (virStorageBackendRBDStreamWait(data, &comps[slot]) < 0)
+                return -1;
+            inflight--;
+
+            if (safewrite(data->fd, bufs[slot], lengths[slot]) < 0) {
+                virReportSystemError(errno, _("unable to write data of RBD image %s"),
+                                     data->imgname);
+                return -1;
+            }
+        }
+
+        if (offset < data->end) {
+            lengths[slot] = MIN(data->chunk, data->end - offset);
+
+            if (virStorageBackendRBDStreamSubmit(data, &comps[slot], offset,
+                                                 lengths[slot], bufs[slot]) < 0)
+                return -1;
+
+            offset += lengths[slot];
+            inflight++;
+        }
+    }
+
+    return 0;
+}
+
+static void
+virStorageBackendRBDStreamThread(void *opaque)
+{
+    virStorageBackendRBDStreamPtr data = opaque;
+    g_autofree rbd_completion_t *comps = g_new0(rbd_completion_t, data->depth);
+    g_autofree char **bufs = g_new0(char *, data->depth);
+    size_t i;
+    int rc;
+
+    for (i = 0; i < data->depth; i++)
+        bufs[i] = g_new0(char, data->chunk);
+
+    if (data->upload)
+        rc = virStorageBackendRBDStreamUpload(data, comps, bufs);
+    else
+        rc = virStorageBackendRBDStreamDownload(data, comps, bufs);
+
+    if (rc < 0)
+        data->err = virSaveLastError();
+
+    /* The stream sees EOF, or fails to write any more data if we gave up */
+    VIR_FORCE_CLOSE(data->fd);
+
+    /* Requests in flight must finish even on failure, they reference
+     * both the image and the buffers */
+    for (i = 0; i < data->depth; i++) {
+        ignore_value(virStorageBackendRBDAioWait(&comps[i]));
+        g_free(bufs[i]);
+    }
+}
+
+static int
+virStorageBackendRBDStreamFinish(virStreamPtr st G_GNUC_UNUSED,
+                                 bool streamAbort,
+                                 void *opaque)
+{
+    virStorageBackendRBDStreamPtr data = opaque;
+
+    virThreadJoin(&data->thread);
+
+    if (!data->err)
+        return 0;
+
+    /* The thread fails to pass data to an aborted stream */
+    if (streamAbort) {
+        VIR_DEBUG("Transfer of RBD image %s aborted: %s",
+                  data->imgname, data->err->message);
+        return 0;
+    }
+
+    virSetError(data->err);
+    return -1;
+}
+
+static int
+virStorageBackendRBDVolStream(virStoragePoolObjPtr pool,
+                              virStorageVolDefPtr vol,
+                              virStreamPtr stream,
+                              unsigned long long offset,
+                              unsigned long long len,
+                              bool upload)
+{
+    virStorageBackendRBDStreamPtr data = NULL;
+    virStoragePoolDefPtr def;
+    rbd_image_info_t info;
+    int fds[2] = { -1, -1 };
+    int ret = -1;
+
+    data = g_new0(virStorageBackendRBDStream, 1);
+    data->fd = -1;
+    data->upload = upload;
+    data->imgname = g_strdup(vol->name);
+
+    virObjectLock(pool);
+    def = virStoragePoolObjGetDef(pool);
+    VIR_DEBUG("%s RBD image %s/%s", upload ? "Uploading" : "Downloading",
+              def->source.name, vol->name);
+    data->ptr = virStorageBackendRBDNewState(pool);
+    virObjectUnlock(pool);
+
+    if (!data->ptr)
+        goto cleanup;
+
+    if (rbd_open(data->ptr->ioctx, vol->name, &data->image, NULL) < 0) {
+        virReportSystemError(errno, _("failed to open the RBD image %s"),
+                             vol->name);
+        goto cleanup;
+    }
+
+    if (rbd_stat(data->image, &info, sizeof(info)) < 0) {
+        virReportSystemError(errno, _("failed to stat the RBD image %s"),
+                             vol->name);
+        goto cleanup;
+    }
+
+    if (upload) {
+        if (offset > info.size || len > info.size - offset) {
+            virReportError(VIR_ERR_INVALID_ARG,
+                           _("range %llu+%llu exceeds the capacity %"PRIu64
+                             " of RBD image %s"),
+                           offset, len, info.size, vol->name);
+            goto cleanup;
+        }
+
+        data->end = len ? offset + len : info.size;
+    } else {
+        data->end = info.size;
+        if (offset > info.size)
+            offset = info.size;
+        if (len && len < info.size - offset)
+            data->end = offset + len;
+    }
+
+    data->offset = offset;
+    data->chunk = info.obj_size;
+    data->depth = virStorageBackendRBDQueueDepth(data->ptr);
+
+    if (pipe(fds) < 0) {
+        virReportSystemError(errno, "%s", _("Unable to create pipe"));
+        goto cleanup;
+    }
+
+    if (upload) {
+        if (virFDStreamOpen(stream, fds[1]) < 0)
+            goto cleanup;
+        fds[1] = -1;
+        data->fd = fds[0];
+        fds[0] = -1;
+    } else {
+        if (virFDStreamOpen(stream, fds[0]) < 0)
+            goto cleanup;
+        fds[0] = -1;
+        data->fd = fds[1];
+        fds[1] = -1;
+    }
+
+    if (virThreadCreateFull(&data->thread, true,
+                            virStorageBackendRBDStreamThread,
+                            "rbd-stream", false, data) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("Unable to create RBD stream thread"));
+        goto cleanup;
+    }
+
+    virFDStreamSetInternalFinishCb(stream, virStorageBackendRBDStreamFinish,
+                                   data, virStorageBackendRBDStreamFree);
+    data = NULL;
+
+    ret = 0;
+
+ cleanup:
+    VIR_FORCE_CLOSE(fds[0]);
+    VIR_FORCE_CLOSE(fds[1]);
+    virStorageBackendRBDStreamFree(data);
+    return ret;
+}
+
+static int
+virStorageBackendRBDVolUpload(virStoragePoolObjPtr pool,
+                              virStorageVolDefPtr vol,
+                              virStreamPtr stream,
+                              unsigned long long offset,
+                              unsigned long long len,
+                              unsigned int flags)
+{
+    virCheckFlags(0, -1);
+
+    return virStorageBackendRBDVolStream(pool, vol, stream,
+                                         offset, len, true);
+}
+
+static int
+virStorageBackendRBDVolDownload(virStoragePoolObjPtr pool,
+                                virStorageVolDefPtr vol,
+                                virStreamPtr stream,
+                                unsigned long long offset,
+                                unsigned long long len,
+                                unsigned int flags)
+{
+    virCheckFlags(0, -1);
+
+    return virStorageBackendRBDVolStream(pool, vol, stream,
+                                         offset, len, false);
+}
+
+
 virStorageBackend virStorageBackendRBD = {
     .type = VIR_STORAGE_POOL_RBD,
 
@@ -1472,7 +1953,9 @@ virStorageBackend virStorageBackendRBD = {
     .refreshVol = virStorageBackendRBDRefreshVol,
     .deleteVol = virStorageBackendRBDDeleteVol,
     .resizeVol = virStorageBackendRBDResizeVol,
-    .wipeVol = virStorageBackendRBDVolWipe
+    .wipeVol = virStorageBackendRBDVolWipe,
+    .uploadVol = virStorageBackendRBDVolUpload,
+    .downloadVol = virStorageBackendRBDVolDownload,
 };
 
 
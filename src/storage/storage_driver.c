@@ -75,6 +75,72 @@ static void storageDriverUnlock(void)
 }
 
 
+static char *
+storagePoolVolCachePath(virStoragePoolObjPtr obj)
+{
+    virStoragePoolDefPtr def = virStoragePoolObjGetDef(obj);
+
+    return virFileBuildPath(driver->stateDir, def->name, ".vols");
+}
+
+
+static void
+storagePoolRemoveVolCache(virStoragePoolObjPtr obj)
+{
+    g_autofree char *cacheFile = storagePoolVolCachePath(obj);
+
+    if (cacheFile)
+        unlink(cacheFile);
+}
+
+
+/* Restore the volumes a pool had before the daemon was restarted so that
+ * an incremental refresh only needs to probe volumes which changed */
+static void
+storagePoolLoadVolCache(virStoragePoolObjPtr obj)
+{
+    virStoragePoolDefPtr def = virStoragePoolObjGetDef(obj);
+    g_autofree char *cacheFile = storagePoolVolCachePath(obj);
+
+    if (!cacheFile)
+        return;
+
+    if (virStorageBackendVolCacheLoad(obj, cacheFile) < 0) {
+        VIR_WARN("Failed to load volume cache of storage pool '%s': %s",
+                 def->name, virGetLastErrorMessage());
+        virResetLastError();
+        virStoragePoolObjClearVols(obj);
+    }
+}
+
+
+static void
+storagePoolSaveVolCache(virStoragePoolObjPtr obj)
+{
+    virStoragePoolDefPtr def = virStoragePoolObjGetDef(obj);
+    g_autofree char *cacheFile = storagePoolVolCachePath(obj);
+
+    if (!cacheFile)
+        return;
+
+    /* An outdated cache is harmless, its entries are validated on load */
+    if (virStorageBackendVolCacheSave(obj, cacheFile) < 0) {
+        VIR_WARN("Failed to save volume cache of storage pool '%s': %s",
+                 def->name, virGetLastErrorMessage());
+        virResetLastError();
+    }
+}
+
+
+/* Drops the volumes of @obj along with the hints of where to look them up */
+static void
+storagePoolClearVols(virStoragePoolObjPtr obj)
+{
+    virStoragePoolObjListForgetPoolVols(driver->pools, obj);
+    virStoragePoolObjClearVols(obj);
+}
+
+
 static void
 storagePoolRefreshFailCleanup(virStorageBackendPtr backend,
                               virStoragePoolObjPtr obj,
@@ -83,7 +149,8 @@ storagePoolRefreshFailCleanup(virStorageBackendPtr backend,
     virErrorPtr orig_err;
 
     virErrorPreserveLast(&orig_err);
-    virStoragePoolObjClearVols(obj);
+    storagePoolClearVols(obj);
+    storagePoolRemoveVolCache(obj);
 
     if (stateFile)
         unlink(stateFile);
@@ -98,12 +165,18 @@ storagePoolRefreshImpl(virStorageBackendPtr backend,
                        virStoragePoolObjPtr obj,
                        const char *stateFile)
 {
-    virStoragePoolObjClearVols(obj);
+    /* Incremental refreshes may drop volumes too */
+    virStoragePoolObjListForgetPoolVols(driver->pools, obj);
+    if (!backend->refreshIncremental)
+        virStoragePoolObjClearVols(obj);
     if (backend->refreshPool(obj) < 0) {
         storagePoolRefreshFailCleanup(backend, obj, stateFile);
         return -1;
     }
 
+    if (backend->refreshIncremental)
+        storagePoolSaveVolCache(obj);
+
     return 0;
 }
 
@@ -153,9 +226,13 @@ storagePoolUpdateStateCallback(virStoragePoolObjPtr obj,
                        _("Failed to initialize storage pool '%s': %s"),
                        def->name, virGetLastErrorMessage());
         unlink(stateFile);
+        storagePoolRemoveVolCache(obj);
         active = false;
     }
 
+    if (active && backend->refreshIncremental)
+        storagePoolLoadVolCache(obj);
+
     /* We can pass NULL as connection, most backends do not use
      * it anyway, but if they do and fail, we want to log error and
      * continue with other pools.
@@ -1112,12 +1189,13 @@ storagePoolDestroy(virStoragePoolPtr pool)
         goto cleanup;
 
     unlink(stateFile);
+    storagePoolRemoveVolCache(obj);
 
     if (backend->stopPool &&
         backend->stopPool(obj) < 0)
         goto cleanup;
 
-    virStoragePoolObjClearVols(obj);
+    storagePoolClearVols(obj);
 
     event = virStoragePoolEventLifecycleNew(def->name,
                                             def->uuid,
@@ -1280,6 +1358,7 @@ storagePoolGetInfo(virStoragePoolPtr pool,
 {
     virStoragePoolObjPtr obj;
     virStoragePoolDefPtr def;
+    virStorageBackendPtr backend;
     int ret = -1;
 
     if (!(obj = virStoragePoolObjFromStoragePool(pool)))
@@ -1289,14 +1368,46 @@ storagePoolGetInfo(virStoragePoolPtr pool,
     if (virStoragePoolGetInfoEnsureACL(pool->conn, def) < 0)
         goto cleanup;
 
-    if (virStorageBackendForType(def->type) == NULL)
+    if ((backend = virStorageBackendForType(def->type)) == NULL)
         goto cleanup;
 
+    /* Volumes may have grown since the last refresh. The size is looked
+     * up without holding the pool lock, so that a hung file system doesn't
+     * block every other API touching the pool. Not being able to tell is
+     * no reason to fail, the last known values are reported then. */
+    if (backend->getPoolSize &&
+        virStoragePoolObjIsActive(obj) &&
+        !virStoragePoolObjIsStarting(obj) &&
+        virStoragePoolObjGetAsyncjobs(obj) == 0) {
+        g_autofree char *target = g_strdup(def->target.path);
+        unsigned long long capacity;
+        unsigned long long allocation;
+        unsigned long long available;
+        int rc;
+
+        virObjectUnlock(obj);
+        rc = backend->getPoolSize(target, &capacity, &allocation, &available);
+        virObjectLock(obj);
+        def = virStoragePoolObjGetDef(obj);
+
+        if (rc < 0) {
+            VIR_WARN("Failed to update size of pool '%s': %s",
+                     def->name, virGetLastErrorMessage());
+            virResetLastError();
+        } else if (virStoragePoolObjIsActive(obj) &&
+                   STREQ_NULLABLE(def->target.path, target)) {
+            def->capacity = capacity;
+            def->allocation = allocation;
+            def->available = available;
+        }
+    }
+
     memset(info, 0, sizeof(virStoragePoolInfo));
-    if (virStoragePoolObjIsActive(obj))
+    if (virStoragePoolObjIsActive(obj)) {
         info->state = VIR_STORAGE_POOL_RUNNING;
-    else
+    } else {
         info->state = VIR_STORAGE_POOL_INACTIVE;
+    }
     info->capacity = def->capacity;
     info->allocation = def->allocation;
     info->available = def->available;
@@ -1589,9 +1700,11 @@ storageVolLookupByKey(virConnectPtr conn,
         .key = key, .voldef = NULL };
     virStorageVolPtr vol = NULL;
 
-    if ((obj = virStoragePoolObjListSearch(driver->pools,
-                                           storageVolLookupByKeyCallback,
-                                           &data)) && data.voldef) {
+    if ((obj = virStoragePoolObjListSearchVol(driver->pools,
+                                              VIR_STORAGE_POOL_OBJ_VOL_HINT_KEY,
+                                              key,
+                                              storageVolLookupByKeyCallback,
+                                              &data)) && data.voldef) {
         def = virStoragePoolObjGetDef(obj);
         if (virStorageVolLookupByKeyEnsureACL(conn, def, data.voldef) == 0) {
             vol = virGetStorageVol(conn, def->name,
@@ -1672,9 +1785,11 @@ storageVolLookupByPath(virConnectPtr conn,
     if (!(data.cleanpath = virFileSanitizePath(path)))
         return NULL;
 
-    if ((obj = virStoragePoolObjListSearch(driver->pools,
-                                           storageVolLookupByPathCallback,
-                                           &data)) && data.voldef) {
+    if ((obj = virStoragePoolObjListSearchVol(driver->pools,
+                                              VIR_STORAGE_POOL_OBJ_VOL_HINT_PATH,
+                                              data.cleanpath,
+                                              storageVolLookupByPathCallback,
+                                              &data)) && data.voldef) {
         def = virStoragePoolObjGetDef(obj);
 
         if (virStorageVolLookupByPathEnsureACL(conn, def, data.voldef) == 0) {
@@ -1772,6 +1887,9 @@ storageVolDeleteInternal(virStorageBackendPtr backend,
         return -1;
     }
 
+    /* The disk backend frees @voldef itself, forget it while we can */
+    virStoragePoolObjListForgetVol(driver->pools, voldef);
+
     if (backend->deleteVol(obj, voldef, flags) < 0)
         return -1;
 
@@ -1999,6 +2117,8 @@ storageVolCreateXML(virStoragePoolPtr pool,
         def->available -= voldef->target.allocation;
     }
 
+    virStoragePoolObjListRememberVol(driver->pools, obj, voldef);
+
     VIR_INFO("Creating volume '%s' in storage pool '%s'",
              newvol->name, def->name);
     vol = g_steal_pointer(&newvol);
@@ -2191,6 +2311,8 @@ storageVolCreateXMLFrom(virStoragePoolPtr pool,
         def->available -= voldef->target.allocation;
     }
 
+    virStoragePoolObjListRememberVol(driver->pools, obj, voldef);
+
     VIR_INFO("Creating volume '%s' in storage pool '%s'",
              newvol->name, def->name);
     vol = g_steal_pointer(&newvol);
@@ -98,6 +98,7 @@ virStorageBackendNamespaceInit(int poolType,
 
 #define READ_BLOCK_SIZE_DEFAULT  (1024 * 1024)
 #define WRITE_BLOCK_SIZE_DEFAULT (4 * 1024)
+#define WIPE_BLOCK_SIZE_DEFAULT  (1024 * 1024)
 
 /*
  * Perform the O(1) btrfs clone operation, if possible.
@@ -120,6 +121,140 @@ reflinkCloneFile(int dest_fd G_GNUC_UNUSED,
 #endif
 
 
+/**
+ * storageBackendCopyFileRange:
+ * @vol: volume being created
+ * @inputvol: volume being copied
+ * @inputfd: file descriptor of @inputvol
+ * @fd: file descriptor of @vol
+ * @total: maximum number of bytes to copy, decreased by the amount copied
+ *
+ * Copy regular files using copy_file_range(), which lets the kernel copy
+ * the data without passing it through user space. Depending on the
+ * filesystem the copy is done by sharing extents, or even offloaded to
+ * the server for network filesystems. Only the data regions reported by
+ * SEEK_DATA/SEEK_HOLE are copied, so holes in @inputvol are kept and
+ * shared extents stay unallocated in @vol.
+ *
+ * Returns 0 on success, 1 if the copy has to be done by reading and
+ * writing the data instead, -errno on failure.
+ */
+#ifdef HAVE_COPY_FILE_RANGE
+static int
+storageBackendCopyFileRange(virStorageVolDefPtr vol,
+                            virStorageVolDefPtr inputvol,
+                            int inputfd,
+                            int fd,
+                            unsigned long long *total)
+{
+    struct stat inputst;
+    struct stat st;
+    off_t pos = 0;
+    off_t end;
+    bool copied = false;
+    int ret;
+
+    if (fstat(inputfd, &inputst) < 0 || fstat(fd, &st) < 0 ||
+        !S_ISREG(inputst.st_mode) || !S_ISREG(st.st_mode))
+        return 1;
+
+    end = inputst.st_size;
+    if ((unsigned long long) end > *total)
+        end = *total;
+
+    while (pos < end) {
+        off_t data;
+        off_t hole = end;
+
+        if ((data = lseek(inputfd, pos, SEEK_DATA)) < 0) {
+            if (errno != ENXIO)
+                goto error;
+            /* the rest of the file is a hole */
+            data = end;
+        }
+        if (data > end)
+            data = end;
+
+        if (data < end &&
+            (hole = lseek(inputfd, data, SEEK_HOLE)) < 0)
+            goto error;
+        if (hole > end)
+            hole = end;
+
+        while (data < hole) {
+            off_t inoff = data;
+            off_t outoff = data;
+            ssize_t rc;
+
+            if ((rc = copy_file_range(inputfd, &inoff, fd, &outoff,
+                                      hole - data, 0)) < 0) {
+                /* e.g. different filesystems on older kernels */
+                if (!copied &&
+                    (errno == EXDEV || errno == EINVAL ||
+                     errno == ENOSYS || errno == EOPNOTSUPP)) {
+                    VIR_DEBUG("copy_file_range not usable to copy '%s': %s",
+                              inputvol->target.path, g_strerror(errno));
+                    goto fallback;
+                }
+                ret = -errno;
+                virReportSystemError(errno,
+                                     _("failed to copy '%s' to '%s'"),
+                                     inputvol->target.path, vol->target.path);
+                return ret;
+            }
+
+            /* input shrank while copying */
+            if (rc == 0) {
+                end = data;
+                break;
+            }
+
+            copied = true;
+            data += rc;
+        }
+
+        pos = hole;
+    }
+
+    /* leave the file offset where the read/write loop would */
+    if (lseek(fd, end, SEEK_SET) < 0) {
+        ret = -errno;
+        virReportSystemError(errno, _("cannot seek in file '%s'"),
+                             vol->target.path);
+        return ret;
+    }
+
+    *total -= end;
+    VIR_DEBUG("copied %lld bytes from '%s' using copy_file_range",
+              (long long) end, inputvol->target.path);
+    return 0;
+
+ fallback:
+    /* SEEK_DATA/SEEK_HOLE moved the offset the buffered copy reads from,
+     * while nothing has been written yet */
+    if (lseek(inputfd, 0, SEEK_SET) < 0)
+        goto error;
+    return 1;
+
+ error:
+    ret = -errno;
+    virReportSystemError(errno, _("cannot seek in file '%s'"),
+                         inputvol->target.path);
+    return ret;
+}
+#else /* !HAVE_COPY_FILE_RANGE */
+static int
+storageBackendCopyFileRange(virStorageVolDefPtr vol G_GNUC_UNUSED,
+                            virStorageVolDefPtr inputvol G_GNUC_UNUSED,
+                            int inputfd G_GNUC_UNUSED,
+                            int fd G_GNUC_UNUSED,
+                            unsigned long long *total G_GNUC_UNUSED)
+{
+    return 1;
+}
+#endif /* !HAVE_COPY_FILE_RANGE */
+
+
 static int ATTRIBUTE_NONNULL(2)
 virStorageBackendCopyToFD(virStorageVolDefPtr vol,
                           virStorageVolDefPtr inputvol,
@@ -130,6 +265,7 @@ virStorageBackendCopyToFD(virStorageVolDefPtr vol,
 {
     int amtread = -1;
     int ret = 0;
+    int rc;
     size_t rbytes = READ_BLOCK_SIZE_DEFAULT;
     int wbytes = 0;
     int interval;
@@ -174,7 +310,17 @@ virStorageBackendCopyToFD(virStorageVolDefPtr vol,
         }
     }
 
-    while (amtread != 0) {
+    /* Only a sparse clone without any requested allocation may leave the
+     * allocation to the kernel, e.g. by sharing extents. Otherwise the
+     * requested space has to be written. */
+    rc = 1;
+    if (want_sparse && !vol->target.allocation &&
+        (rc = storageBackendCopyFileRange(vol, inputvol, inputfd, fd,
+                                          total)) < 0)
+        return rc;
+
+    /* Fall back to copying the data through a buffer */
+    while (rc > 0 && amtread != 0) {
         int amtleft;
 
         if (*total < rbytes)
@@ -2551,6 +2697,101 @@ storageBackendWipeLocal(const char *path,
 }
 
 
+/**
+ * storageBackendWipeOffload:
+ * @path: path of the volume
+ * @fd: file descriptor of the volume, opened for writing
+ * @st: result of fstat() on @fd
+ * @discard: discard the data rather than zero it
+ * @wipe_len: number of bytes to wipe
+ * @zero_end: wipe the last @wipe_len bytes rather than the first ones
+ *
+ * Let the kernel wipe the volume rather than writing zeroes to it
+ * ourselves. Block devices are asked to zero the range with BLKZEROOUT,
+ * which the storage can offload (e.g. as WRITE SAME) and which overwrites
+ * the data, or to discard it with BLKDISCARD. Regular files can only be
+ * discarded by punching the range out. Zeroing them is left to the
+ * caller: FALLOC_FL_ZERO_RANGE just marks extents unwritten and leaves
+ * the old data on the disk.
+ *
+ * Returns 0 on success, 1 if the volume doesn't support it, -1 on error.
+ */
+static int
+storageBackendWipeOffload(const char *path,
+                          int fd,
+                          const struct stat *st G_GNUC_UNUSED,
+                          bool discard G_GNUC_UNUSED,
+                          unsigned long long wipe_len,
+                          bool zero_end)
+{
+    unsigned long long offset = 0;
+    int rc = -1;
+
+    if (zero_end) {
+        off_t end;
+
+        if ((end = lseek(fd, 0, SEEK_END)) < 0) {
+            virReportSystemError(errno,
+                                 _("Failed to seek to the end in volume "
+                                   "with path '%s'"),
+                                 path);
+            return -1;
+        }
+
+        /* let the caller fail the usual way */
+        if (wipe_len > (unsigned long long) end)
+            return 1;
+
+        offset = end - wipe_len;
+    }
+
+    errno = EOPNOTSUPP;
+
+#if defined(__linux__) && defined(BLKZEROOUT) && defined(BLKDISCARD)
+    if (S_ISBLK(st->st_mode)) {
+        uint64_t range[2] = { offset, wipe_len };
+
+        rc = ioctl(fd, discard ? BLKDISCARD : BLKZEROOUT, range);
+    }
+#endif
+
+#if defined(HAVE_FALLOCATE) && defined(FALLOC_FL_PUNCH_HOLE)
+    if (S_ISREG(st->st_mode) && discard)
+        rc = fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                       offset, wipe_len);
+#endif
+
+    if (rc < 0) {
+        /* EINVAL is returned e.g. for ranges which are not aligned to
+         * the logical block size of a block device */
+        if (errno == EOPNOTSUPP || errno == ENOTTY ||
+            errno == ENOSYS || errno == EINVAL) {
+            VIR_DEBUG("Volume with path '%s' can't be wiped by the kernel: %s",
+                      path, g_strerror(errno));
+            return 1;
+        }
+
+        virReportSystemError(errno,
+                             _("Failed to wipe %llu bytes of storage volume "
+                               "with path '%s'"),
+                             wipe_len, path);
+        return -1;
+    }
+
+    if (virFileDataSync(fd) < 0) {
+        virReportSystemError(errno,
+                             _("cannot sync data to volume with path '%s'"),
+                             path);
+        return -1;
+    }
+
+    VIR_DEBUG("Wiped %llu bytes of volume with path '%s' by %s",
+              wipe_len, path, discard ? "discarding" : "zeroing");
+
+    return 0;
+}
+
+
 static int
 storageBackendVolWipeLocalFile(const char *path,
                                unsigned int algorithm,
@@ -2561,6 +2802,7 @@ storageBackendVolWipeLocalFile(const char *path,
     struct stat st;
     VIR_AUTOCLOSE fd = -1;
     g_autoptr(virCommand) cmd = NULL;
+    int rc;
 
     fd = open(path, O_RDWR);
     if (fd == -1) {
@@ -2606,9 +2848,8 @@ storageBackendVolWipeLocalFile(const char *path,
         alg_char = "random";
         break;
     case VIR_STORAGE_VOL_WIPE_ALG_TRIM:
-        virReportError(VIR_ERR_ARGUMENT_UNSUPPORTED, "%s",
-                       _("'trim' algorithm not supported"));
-        return -1;
+        alg_char = "trim";
+        break;
     case VIR_STORAGE_VOL_WIPE_ALG_LAST:
         virReportError(VIR_ERR_INVALID_ARG,
                        _("unsupported algorithm %d"),
@@ -2618,6 +2859,16 @@ storageBackendVolWipeLocalFile(const char *path,
 
     VIR_DEBUG("Wiping file '%s' with algorithm '%s'", path, alg_char);
 
+    if (algorithm == VIR_STORAGE_VOL_WIPE_ALG_TRIM) {
+        if ((rc = storageBackendWipeOffload(path, fd, &st, true,
+                                            allocation, zero_end)) <= 0)
+            return rc;
+
+        virReportError(VIR_ERR_ARGUMENT_UNSUPPORTED, "%s",
+                       _("'trim' algorithm not supported"));
+        return -1;
+    }
+
     if (algorithm != VIR_STORAGE_VOL_WIPE_ALG_ZERO) {
         cmd = virCommandNew(SCRUB);
         virCommandAddArgList(cmd, "-f", "-p", alg_char, path, NULL);
@@ -2628,7 +2879,15 @@ storageBackendVolWipeLocalFile(const char *path,
     if (S_ISREG(st.st_mode) && st.st_blocks < (st.st_size / DEV_BSIZE))
         return storageBackendVolZeroSparseFileLocal(path, st.st_size, fd);
 
-    return storageBackendWipeLocal(path, fd, allocation, st.st_blksize,
+    /* Only block devices can be zeroed by the kernel, files need the data
+     * to be actually overwritten */
+    if (S_ISBLK(st.st_mode) &&
+        (rc = storageBackendWipeOffload(path, fd, &st, false,
+                                        allocation, zero_end)) <= 0)
+        return rc;
+
+    return storageBackendWipeLocal(path, fd, allocation,
+                                   MAX(st.st_blksize, WIPE_BLOCK_SIZE_DEFAULT),
                                    zero_end);
 }
 
@@ -3473,9 +3732,239 @@ virStorageBackendRefreshVolTargetUpdate(virStorageVolDefPtr vol)
 }
 
 
+static void
+storageBackendProbeStampFromStat(virStorageVolProbeStampPtr stamp,
+                                 const struct stat *sb)
+{
+    struct timespec mt = get_stat_mtime(sb);
+    struct timespec ct = get_stat_ctime(sb);
+
+    stamp->dev = sb->st_dev;
+    stamp->ino = sb->st_ino;
+    stamp->size = sb->st_size;
+    stamp->mtime = mt.tv_sec * 1000000000LL + mt.tv_nsec;
+    stamp->ctime = ct.tv_sec * 1000000000LL + ct.tv_nsec;
+}
+
+
+static bool
+storageBackendProbeStampEqual(const virStorageVolProbeStamp *a,
+                              const virStorageVolProbeStamp *b)
+{
+    return a->dev == b->dev &&
+           a->ino == b->ino &&
+           a->size == b->size &&
+           a->mtime == b->mtime &&
+           a->ctime == b->ctime;
+}
+
+
+/**
+ * storageBackendRefreshLocalReuse:
+ * @pool: pool object
+ * @name: name of the directory entry
+ * @stamp: identity of the entry as found now, or NULL if it can't be stat'ed
+ *
+ * Check whether volume @name already known to @pool was probed from the
+ * very same, unmodified file. If so, the volume is kept as it is.
+ * Otherwise any stale definition of the volume is dropped from @pool
+ * so that the entry can be probed again.
+ *
+ * Ploop volumes are directories whose contents can change without their
+ * own timestamps changing, so they are always probed again.
+ *
+ * Returns true if the existing volume was kept, false otherwise.
+ */
+static bool
+storageBackendRefreshLocalReuse(virStoragePoolObjPtr pool,
+                                const char *name,
+                                const virStorageVolProbeStamp *stamp)
+{
+    virStorageVolDefPtr vol;
+
+    if (!(vol = virStorageVolDefFindByName(pool, name)))
+        return false;
+
+    if (stamp &&
+        vol->type != VIR_STORAGE_VOL_PLOOP &&
+        storageBackendProbeStampEqual(&vol->stamp, stamp))
+        return true;
+
+    virStoragePoolObjRemoveVol(pool, vol);
+    return false;
+}
+
+
+struct storageBackendRefreshLocalStaleData {
+    virHashTablePtr seen;
+    char ***names;
+    size_t *nnames;
+};
+
+
+static int
+storageBackendRefreshLocalCollectStale(virStorageVolDefPtr voldef,
+                                       const void *opaque)
+{
+    const struct storageBackendRefreshLocalStaleData *data = opaque;
+    g_autofree char *name = NULL;
+
+    if (virHashHasEntry(data->seen, voldef->name))
+        return 0;
+
+    name = g_strdup(voldef->name);
+    return VIR_APPEND_ELEMENT(*data->names, *data->nnames, name);
+}
+
+
+/**
+ * storageBackendRefreshLocalRemoveStale:
+ * @pool: pool object
+ * @seen: names of all entries found in the pool directory
+ *
+ * Drop all volumes of @pool which are no longer present in its directory.
+ */
+static int
+storageBackendRefreshLocalRemoveStale(virStoragePoolObjPtr pool,
+                                      virHashTablePtr seen)
+{
+    char **names = NULL;
+    size_t nnames = 0;
+    struct storageBackendRefreshLocalStaleData data = {
+        .seen = seen, .names = &names, .nnames = &nnames };
+    size_t i;
+    int ret = -1;
+
+    if (virStoragePoolObjForEachVolume(pool,
+                                       storageBackendRefreshLocalCollectStale,
+                                       &data) < 0)
+        goto cleanup;
+
+    for (i = 0; i < nnames; i++) {
+        virStorageVolDefPtr vol;
+
+        if ((vol = virStorageVolDefFindByName(pool, names[i])))
+            virStoragePoolObjRemoveVol(pool, vol);
+    }
+
+    ret = 0;
+ cleanup:
+    virStringListFreeCount(names, nnames);
+    return ret;
+}
+
+
+struct storageBackendRefreshLocalProbeData {
+    virStorageVolDefPtr *vols;
+    int *rc;
+    virErrorPtr *errors;
+    int nvols;
+    int next;
+    int failed;
+};
+
+
+static void
+storageBackendRefreshLocalProbeWorker(void *opaque)
+{
+    struct storageBackendRefreshLocalProbeData *data = opaque;
+    int i;
+
+    while (!g_atomic_int_get(&data->failed) &&
+           (i = g_atomic_int_add(&data->next, 1)) < data->nvols) {
+        data->rc[i] = virStorageBackendRefreshVolTargetUpdate(data->vols[i]);
+
+        if (data->rc[i] == -1) {
+            data->errors[i] = virSaveLastError();
+            g_atomic_int_set(&data->failed, 1);
+        }
+    }
+}
+
+
+/**
+ * storageBackendRefreshLocalProbe:
+ * @vols: volumes to probe
+ * @rc: filled with the return value of
+ *      virStorageBackendRefreshVolTargetUpdate for each of @vols
+ * @nvols: number of elements in @vols and @rc
+ * @nthreads: maximum number of volumes probed at the same time
+ *
+ * Probe @vols using up to @nthreads threads, the calling one included.
+ * On high latency storage probing a volume is dominated by waiting for
+ * the file to be opened and its header read, so probing several volumes
+ * at once speeds up refreshing large pools almost linearly.
+ *
+ * Returns 0 on success, -1 with the error of the failing probe reported
+ * if any of the volumes failed to be probed.
+ */
+static int
+storageBackendRefreshLocalProbe(virStorageVolDefPtr *vols,
+                                int *rc,
+                                size_t nvols,
+                                unsigned int nthreads)
+{
+    struct storageBackendRefreshLocalProbeData data = {
+        .vols = vols, .rc = rc, .nvols = nvols };
+    g_autofree virThread *threads = NULL;
+    g_autofree virErrorPtr *errors = NULL;
+    size_t nstarted = 0;
+    size_t i;
+    int ret = 0;
+
+    if (nvols == 0)
+        return 0;
+
+    if (nthreads > nvols)
+        nthreads = nvols;
+
+    errors = g_new0(virErrorPtr, nvols);
+    data.errors = errors;
+
+    if (nthreads > 1)
+        threads = g_new0(virThread, nthreads - 1);
+
+    for (i = 0; i + 1 < nthreads; i++) {
+        if (virThreadCreateFull(&threads[nstarted], true,
+                                storageBackendRefreshLocalProbeWorker,
+                                "vol-probe", false, &data) < 0) {
+            VIR_WARN("Failed to start volume probe thread, "
+                     "probing with %zu threads only", nstarted + 1);
+            break;
+        }
+        nstarted++;
+    }
+
+    storageBackendRefreshLocalProbeWorker(&data);
+
+    for (i = 0; i < nstarted; i++)
+        virThreadJoin(&threads[i]);
+
+    for (i = 0; i < nvols; i++) {
+        if (errors[i] && ret == 0) {
+            virSetError(errors[i]);
+            ret = -1;
+        }
+        virFreeError(errors[i]);
+    }
+
+    return ret;
+}
+
+
 /**
  * Iterate over the pool's directory and enumerate all disk images
  * within it. This is non-recursive.
+ *
+ * Volumes already known to the pool are kept without probing them
+ * again as long as the file they were probed from is unchanged, i.e.
+ * it has the same device, inode, size, mtime and ctime. Only new or
+ * modified files are opened, which keeps refreshing large pools on
+ * high latency storage cheap. Volumes whose file disappeared are
+ * removed from the pool.
+ *
+ * New or modified files are probed by as many threads as the pool's
+ * <refresh><probe threads/> setting allows.
  */
 int
 virStorageBackendRefreshLocal(virStoragePoolObjPtr pool)
@@ -3483,19 +3972,32 @@ virStorageBackendRefreshLocal(virStoragePoolObjPtr pool)
     virStoragePoolDefPtr def = virStoragePoolObjGetDef(pool);
     DIR *dir;
     struct dirent *ent;
-    struct statvfs sb;
     struct stat statbuf;
     int direrr;
     int ret = -1;
     g_autoptr(virStorageVolDef) vol = NULL;
     VIR_AUTOCLOSE fd = -1;
     g_autoptr(virStorageSource) target = NULL;
+    g_autoptr(virHashTable) seen = NULL;
+    virStorageVolDefPtr *vols = NULL;
+    size_t nvols = 0;
+    g_autofree int *rc = NULL;
+    unsigned int nthreads = 1;
+    size_t i;
+
+    if (def->refresh && def->refresh->probe.threads)
+        nthreads = def->refresh->probe.threads;
+
+    if (!(seen = virHashNew(NULL)))
+        return -1;
 
     if (virDirOpen(&dir, def->target.path) < 0)
         goto cleanup;
 
     while ((direrr = virDirRead(dir, &ent, def->target.path)) > 0) {
-        int err;
+        virStorageVolProbeStamp stamp = { 0 };
+        bool haveStamp = false;
+        g_autofree char *path = NULL;
 
         if (virStringHasControlChars(ent->d_name)) {
             VIR_WARN("Ignoring file '%s' with control characters under '%s'",
@@ -3503,35 +4005,61 @@ virStorageBackendRefreshLocal(virStoragePoolObjPtr pool)
             continue;
         }
 
+        if (virHashAddEntry(seen, ent->d_name, NULL) < 0)
+            goto cleanup;
+
+        path = g_strdup_printf("%s/%s", def->target.path, ent->d_name);
+
+        if (stat(path, &statbuf) == 0) {
+            storageBackendProbeStampFromStat(&stamp, &statbuf);
+            haveStamp = true;
+        }
+
+        if (storageBackendRefreshLocalReuse(pool, ent->d_name,
+                                            haveStamp ? &stamp : NULL))
+            continue;
+
         if (VIR_ALLOC(vol) < 0)
             goto cleanup;
 
         vol->name = g_strdup(ent->d_name);
 
         vol->type = VIR_STORAGE_VOL_FILE;
-        vol->target.path = g_strdup_printf("%s/%s", def->target.path, vol->name);
+        vol->target.path = g_steal_pointer(&path);
 
         vol->key = g_strdup(vol->target.path);
 
-        if ((err = virStorageBackendRefreshVolTargetUpdate(vol)) < 0) {
-            if (err == -2) {
-                /* Silently ignore non-regular files,
-                 * eg 'lost+found', dangling symbolic link */
-                virStorageVolDefFree(vol);
-                vol = NULL;
-                continue;
-            }
-            goto cleanup;
-        }
+        /* The stamp is taken before probing, so a file modified in
+         * between is simply probed again on the next refresh. */
+        if (haveStamp)
+            vol->stamp = stamp;
 
-        if (virStoragePoolObjAddVol(pool, vol) < 0)
+        if (VIR_APPEND_ELEMENT(vols, nvols, vol) < 0)
             goto cleanup;
-        vol = NULL;
     }
     if (direrr < 0)
         goto cleanup;
     VIR_DIR_CLOSE(dir);
 
+    rc = g_new0(int, nvols);
+
+    if (storageBackendRefreshLocalProbe(vols, rc, nvols, nthreads) < 0)
+        goto cleanup;
+
+    for (i = 0; i < nvols; i++) {
+        /* Silently ignore non-regular files,
+         * eg 'lost+found', dangling symbolic link */
+        if (rc[i] == -2)
+            continue;
+
+        if (virStoragePoolObjAddVol(pool, vols[i]) < 0)
+            goto cleanup;
+        vols[i] = NULL;
+    }
+
+    if (storageBackendRefreshLocalRemoveStale(pool, seen) < 0)
+        goto cleanup;
+
     if (!(target = virStorageSourceNew()))
         goto cleanup;
 
@@ -3553,18 +4081,11 @@ virStorageBackendRefreshLocal(virStoragePoolObjPtr pool)
         goto cleanup;
 
     /* VolTargetInfoFD doesn't update capacity correctly for the pool case */
-    if (statvfs(def->target.path, &sb) < 0) {
-        virReportSystemError(errno,
-                             _("cannot statvfs path '%s'"),
-                             def->target.path);
+    if (virStorageBackendGetLocalSize(def->target.path,
+                                      &def->capacity,
+                                      &def->allocation,
+                                      &def->available) < 0)
         goto cleanup;
-    }
-
-    def->capacity = ((unsigned long long)sb.f_frsize *
-                     (unsigned long long)sb.f_blocks);
-    def->available = ((unsigned long long)sb.f_bfree *
-                      (unsigned long long)sb.f_frsize);
-    def->allocation = def->capacity - def->available;
 
     def->target.perms.mode = target->perms->mode;
     def->target.perms.uid = target->perms->uid;
@@ -3575,10 +4096,224 @@ virStorageBackendRefreshLocal(virStoragePoolObjPtr pool)
     ret = 0;
  cleanup:
     VIR_DIR_CLOSE(dir);
+    for (i = 0; i < nvols; i++)
+        virStorageVolDefFree(vols[i]);
+    VIR_FREE(vols);
     return ret;
 }
 
 
+/**
+ * virStorageBackendGetLocalSize:
+ * @target: target directory of a pool
+ * @capacity: filled with the capacity of the pool
+ * @allocation: filled with the allocation of the pool
+ * @available: filled with the space available in the pool
+ *
+ * Gets the size of a pool from the file system its target directory lives
+ * on. Thin provisioned volumes growing over time are reflected without
+ * having to rescan the whole pool. As statvfs() may block for a long time
+ * on network file systems, this doesn't touch the pool object itself.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virStorageBackendGetLocalSize(const char *target,
+                              unsigned long long *capacity,
+                              unsigned long long *allocation,
+                              unsigned long long *available)
+{
+    struct statvfs sb;
+
+    if (statvfs(target, &sb) < 0) {
+        virReportSystemError(errno,
+                             _("cannot statvfs path '%s'"),
+                             target);
+        return -1;
+    }
+
+    *capacity = ((unsigned long long)sb.f_frsize *
+                 (unsigned long long)sb.f_blocks);
+    *available = ((unsigned long long)sb.f_bfree *
+                  (unsigned long long)sb.f_frsize);
+    *allocation = *capacity - *available;
+
+    return 0;
+}
+
+
+struct storageBackendVolCacheData {
+    virStoragePoolDefPtr def;
+    virBufferPtr buf;
+};
+
+
+static int
+storageBackendVolCacheFormatOne(virStorageVolDefPtr vol,
+                                const void *opaque)
+{
+    const struct storageBackendVolCacheData *data = opaque;
+    g_autofree char *xml = NULL;
+
+    /* Volumes which were not probed from a file can't be validated
+     * when the cache is loaded, leave them out */
+    if (vol->stamp.dev == 0 && vol->stamp.ino == 0)
+        return 0;
+
+    if (!(xml = virStorageVolDefFormat(data->def, vol))) {
+        VIR_DEBUG("Not caching volume '%s': %s",
+                  vol->name, virGetLastErrorMessage());
+        virResetLastError();
+        return 0;
+    }
+
+    virBufferAsprintf(data->buf,
+                      "<entry dev='%llu' ino='%llu' size='%llu' "
+                      "mtime='%lld' ctime='%lld'>\n",
+                      vol->stamp.dev, vol->stamp.ino, vol->stamp.size,
+                      vol->stamp.mtime, vol->stamp.ctime);
+    virBufferAddStr(data->buf, xml);
+    virBufferAddLit(data->buf, "</entry>\n");
+    return 0;
+}
+
+
+/**
+ * virStorageBackendVolCacheSave:
+ * @pool: pool object
+ * @path: file to store the cache in
+ *
+ * Store all volumes of @pool which were probed from a file, together
+ * with the identity of that file, in @path. After a daemon restart the
+ * volumes can then be restored by virStorageBackendVolCacheLoad and
+ * only need to be probed again if their file changed.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virStorageBackendVolCacheSave(virStoragePoolObjPtr pool,
+                              const char *path)
+{
+    virStoragePoolDefPtr def = virStoragePoolObjGetDef(pool);
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    g_autofree char *xml = NULL;
+    struct storageBackendVolCacheData data = { .def = def, .buf = &buf };
+
+    virBufferEscapeString(&buf, "<volumes target='%s'>\n", def->target.path);
+    if (virStoragePoolObjForEachVolume(pool, storageBackendVolCacheFormatOne,
+                                       &data) < 0)
+        return -1;
+    virBufferAddLit(&buf, "</volumes>\n");
+
+    xml = virBufferContentAndReset(&buf);
+
+    return virFileRewriteStr(path, S_IRUSR | S_IWUSR, xml);
+}
+
+
+static int
+storageBackendVolCacheParseStamp(xmlNodePtr node,
+                                 virStorageVolProbeStampPtr stamp)
+{
+    g_autofree char *dev = virXMLPropString(node, "dev");
+    g_autofree char *ino = virXMLPropString(node, "ino");
+    g_autofree char *size = virXMLPropString(node, "size");
+    g_autofree char *mtime = virXMLPropString(node, "mtime");
+    g_autofree char *ctime_str = virXMLPropString(node, "ctime");
+
+    if (!dev || virStrToLong_ull(dev, NULL, 10, &stamp->dev) < 0 ||
+        !ino || virStrToLong_ull(ino, NULL, 10, &stamp->ino) < 0 ||
+        !size || virStrToLong_ull(size, NULL, 10, &stamp->size) < 0 ||
+        !mtime || virStrToLong_ll(mtime, NULL, 10, &stamp->mtime) < 0 ||
+        !ctime_str || virStrToLong_ll(ctime_str, NULL, 10, &stamp->ctime) < 0) {
+        virReportError(VIR_ERR_XML_ERROR, "%s",
+                       _("malformed volume cache entry"));
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/**
+ * virStorageBackendVolCacheLoad:
+ * @pool: pool object
+ * @path: file written by virStorageBackendVolCacheSave
+ *
+ * Add the volumes stored in @path to @pool. The volumes keep the identity
+ * of the file they were probed from, so the next refresh of @pool only
+ * probes those whose file changed in the meantime. A cache written for
+ * a different target path is ignored.
+ *
+ * Returns 0 on success (including when @path does not exist), -1 on
+ * error in which case some volumes might have been added already.
+ */
+int
+virStorageBackendVolCacheLoad(virStoragePoolObjPtr pool,
+                              const char *path)
+{
+    virStoragePoolDefPtr def = virStoragePoolObjGetDef(pool);
+    g_autoptr(xmlDoc) xml = NULL;
+    g_autoptr(xmlXPathContext) ctxt = NULL;
+    g_autofree xmlNodePtr *nodes = NULL;
+    g_autofree char *target = NULL;
+    size_t i;
+    int n;
+
+    if (!virFileExists(path))
+        return 0;
+
+    if (!(xml = virXMLParseFileCtxt(path, &ctxt)))
+        return -1;
+
+    if (!virXMLNodeNameEqual(ctxt->node, "volumes")) {
+        virReportError(VIR_ERR_XML_ERROR,
+                       _("unexpected root element <%s> in volume cache '%s'"),
+                       ctxt->node->name, path);
+        return -1;
+    }
+
+    target = virXMLPropString(ctxt->node, "target");
+    if (STRNEQ_NULLABLE(target, def->target.path)) {
+        VIR_DEBUG("Ignoring volume cache '%s' of target '%s'",
+                  path, NULLSTR(target));
+        return 0;
+    }
+
+    if ((n = virXPathNodeSet("./entry", ctxt, &nodes)) < 0)
+        return -1;
+
+    for (i = 0; i < n; i++) {
+        g_autoptr(virStorageVolDef) vol = NULL;
+        virStorageVolProbeStamp stamp;
+        xmlNodePtr volnode;
+
+        ctxt->node = nodes[i];
+
+        if (storageBackendVolCacheParseStamp(nodes[i], &stamp) < 0)
+            return -1;
+
+        if (!(volnode = virXPathNode("./volume", ctxt))) {
+            virReportError(VIR_ERR_XML_ERROR, "%s",
+                           _("malformed volume cache entry"));
+            return -1;
+        }
+
+        if (!(vol = virStorageVolDefParseNode(def, xml, volnode,
+                                              VIR_VOL_XML_PARSE_STATUS)))
+            return -1;
+
+        vol->stamp = stamp;
+
+        if (virStoragePoolObjAddVol(pool, vol) < 0)
+            return -1;
+        vol = NULL;
+    }
+
+    return 0;
+}
+
+
 static char *
 virStorageBackendSCSISerial(const char *dev,
                             bool isNPIV)
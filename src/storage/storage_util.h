@@ -104,6 +104,15 @@ int
 virStorageBackendRefreshVolTargetUpdate(virStorageVolDefPtr vol);
 
 int virStorageBackendRefreshLocal(virStoragePoolObjPtr pool);
+int virStorageBackendGetLocalSize(const char *target,
+                                  unsigned long long *capacity,
+                                  unsigned long long *allocation,
+                                  unsigned long long *available);
+
+int virStorageBackendVolCacheSave(virStoragePoolObjPtr pool,
+                                  const char *path);
+int virStorageBackendVolCacheLoad(virStoragePoolObjPtr pool,
+                                  const char *path);
 
 int virStorageUtilGlusterExtractPoolSources(const char *host,
                                             const char *xml,
@@ -27,6 +27,8 @@
 
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
 
 #include "virutil.h"
 #include "virthread.h"
@@ -39,36 +41,205 @@
 
 #define VIR_FROM_THIS VIR_FROM_STORAGE
 
+/* Number of buffers in flight between the reading and the writing thread */
+#define IOHELPER_NBUFFERS 4
+
+typedef struct _runIOBuffer runIOBuffer;
+struct _runIOBuffer {
+    char *buf; /* Aligned location within base */
+    void *base; /* Location to be freed */
+    ssize_t len; /* Amount of data in buf, 0 on EOF */
+};
+
+typedef struct _runIOData runIOData;
+struct _runIOData {
+    int fd;
+    int fdin;
+    bool direct;
+    size_t buflen;
+
+    virMutex lock;
+    virCond cond;
+    runIOBuffer bufs[IOHELPER_NBUFFERS];
+    size_t head; /* next buffer to be filled by the reader */
+    size_t tail; /* next buffer to be consumed by the writer */
+    size_t count; /* number of filled buffers */
+    bool quit; /* the writer is done, the reader should stop */
+    int readErrno;
+
+    /* Written to by the writer when it gives up, so that a reader waiting
+     * for input that may never come wakes up */
+    int wakeupfd[2];
+};
+
+
+/* Waits until data->fdin can be read from without blocking. Returns
+ * false if the writer gave up in the meantime. */
+static bool
+runIOReaderWait(runIOData *data)
+{
+    struct pollfd fds[] = {
+        { .fd = data->fdin, .events = POLLIN },
+        { .fd = data->wakeupfd[0], .events = POLLIN },
+    };
+
+    while (poll(fds, G_N_ELEMENTS(fds), -1) < 0) {
+        /* let the read report the error */
+        if (errno != EINTR && errno != EAGAIN)
+            return true;
+    }
+
+    return !(fds[1].revents & (POLLIN | POLLHUP | POLLERR));
+}
+
+
+/* Reads up to data->buflen bytes into @buf, reading again until the
+ * buffer is full or EOF is reached if @fill is true. Waits for input
+ * rather than in read(), so that it can stop waiting once the writer
+ * gives up.
+ *
+ * Returns the number of bytes read, -1 on error with errno set, or -2
+ * if the writer gave up. */
+static ssize_t
+runIOReaderFill(runIOData *data, char *buf, bool fill)
+{
+    size_t got = 0;
+
+    while (got < data->buflen) {
+        ssize_t rc;
+
+        if (!runIOReaderWait(data))
+            return -2;
+
+        if ((rc = read(data->fdin, buf + got, data->buflen - got)) < 0) {
+            if (errno == EINTR || errno == EAGAIN)
+                continue;
+            return -1;
+        }
+
+        if (rc == 0)
+            break;
+
+        got += rc;
+
+        if (!fill)
+            break;
+    }
+
+    return got;
+}
+
+
+static void
+runIOReader(void *opaque)
+{
+    runIOData *data = opaque;
+
+    while (1) {
+        runIOBuffer *buf;
+        ssize_t got;
+
+        virMutexLock(&data->lock);
+        while (data->count == IOHELPER_NBUFFERS && !data->quit)
+            ignore_value(virCondWait(&data->cond, &data->lock));
+        if (data->quit) {
+            virMutexUnlock(&data->lock);
+            return;
+        }
+        buf = &data->bufs[data->head];
+        virMutexUnlock(&data->lock);
+
+        /* If we read with O_DIRECT from file we can't read the buffer
+         * in pieces as it can lead to unaligned read after reading last
+         * bytes. If we write with O_DIRECT we should fill the whole buffer
+         * so that writes will be aligned.
+         * In other cases filling the buffer reduces number of syscalls.
+         */
+        if ((got = runIOReaderFill(data, buf->buf,
+                                   data->fdin != data->fd ||
+                                   !data->direct)) == -2)
+            return;
+
+        virMutexLock(&data->lock);
+        if (got < 0) {
+            data->readErrno = errno;
+            got = 0;
+        }
+        buf->len = got;
+        data->head = (data->head + 1) % IOHELPER_NBUFFERS;
+        data->count++;
+        virCondSignal(&data->cond);
+        virMutexUnlock(&data->lock);
+
+        if (got == 0)
+            return;
+    }
+}
+
+
+/* Stops the reader, which may be waiting for a free buffer or for input
+ * from a peer that will never send any more, and waits for it to exit */
+static void
+runIOReaderStop(runIOData *data, virThreadPtr reader)
+{
+    virMutexLock(&data->lock);
+    data->quit = true;
+    virCondSignal(&data->cond);
+    virMutexUnlock(&data->lock);
+    ignore_value(safewrite(data->wakeupfd[1], "q", 1));
+    virThreadJoin(reader);
+}
+
+
+static bool
+runIOBufferIsZero(const char *buf, size_t len)
+{
+    return len > 0 && buf[0] == 0 && memcmp(buf, buf + 1, len - 1) == 0;
+}
+
+
 static int
 runIO(const char *path, int fd, int oflags)
 {
-    g_autofree void *base = NULL; /* Location to be freed */
-    char *buf = NULL; /* Aligned location within base */
-    size_t buflen = 1024*1024;
+    runIOData data = { .fd = fd, .buflen = 1024*1024,
+                       .wakeupfd = { -1, -1 } };
     intptr_t alignMask = 64*1024 - 1;
     int ret = -1;
-    int fdin, fdout;
+    int fdout;
     const char *fdinname, *fdoutname;
     unsigned long long total = 0;
     bool direct = O_DIRECT && ((oflags & O_DIRECT) != 0);
+    bool sparse = false;
+    bool haveLock = false;
+    bool haveCond = false;
+    virThread reader;
+    bool haveReader = false;
     off_t end = 0;
+    struct stat sb;
+    size_t i;
+
+    data.direct = direct;
+
+    for (i = 0; i < IOHELPER_NBUFFERS; i++) {
+        runIOBuffer *buf = &data.bufs[i];
 
 #if HAVE_POSIX_MEMALIGN
-    if (posix_memalign(&base, alignMask + 1, buflen)) {
-        virReportOOMError();
-        goto cleanup;
-    }
-    buf = base;
+        if (posix_memalign(&buf->base, alignMask + 1, data.buflen)) {
+            virReportOOMError();
+            goto cleanup;
+        }
+        buf->buf = buf->base;
 #else
-    if (VIR_ALLOC_N(buf, buflen + alignMask) < 0)
-        goto cleanup;
-    base = buf;
-    buf = (char *) (((intptr_t) base + alignMask) & ~alignMask);
+        if (VIR_ALLOC_N(buf->buf, data.buflen + alignMask) < 0)
+            goto cleanup;
+        buf->base = buf->buf;
+        buf->buf = (char *) (((intptr_t) buf->base + alignMask) & ~alignMask);
 #endif
+    }
 
     switch (oflags & O_ACCMODE) {
     case O_RDONLY:
-        fdin = fd;
+        data.fdin = fd;
         fdinname = path;
         fdout = STDOUT_FILENO;
         fdoutname = "stdout";
@@ -81,7 +252,7 @@ runIO(const char *path, int fd, int oflags)
         }
         break;
     case O_WRONLY:
-        fdin = STDIN_FILENO;
+        data.fdin = STDIN_FILENO;
         fdinname = "stdin";
         fdout = fd;
         fdoutname = path;
@@ -92,6 +263,11 @@ runIO(const char *path, int fd, int oflags)
                                  _("O_DIRECT write needs empty seekable file"));
             goto cleanup;
         }
+        /* Blocks of zeroes written to an empty regular file can be left
+         * as holes, which read back as zeroes anyway. */
+        if (fstat(fd, &sb) == 0 && S_ISREG(sb.st_mode) && sb.st_size == 0 &&
+            lseek(fd, 0, SEEK_CUR) == 0)
+            sparse = true;
         break;
 
     case O_RDWR:
@@ -102,39 +278,52 @@ runIO(const char *path, int fd, int oflags)
         goto cleanup;
     }
 
+    if (virMutexInit(&data.lock) < 0) {
+        virReportSystemError(errno, "%s", _("Unable to initialize mutex"));
+        goto cleanup;
+    }
+    haveLock = true;
+
+    if (virCondInit(&data.cond) < 0) {
+        virReportSystemError(errno, "%s", _("Unable to initialize condition"));
+        goto cleanup;
+    }
+    haveCond = true;
+
+    if (pipe(data.wakeupfd) < 0) {
+        virReportSystemError(errno, "%s", _("Unable to create pipe"));
+        goto cleanup;
+    }
+
+    /* Read the next buffers while the current one is being written */
+    if (virThreadCreate(&reader, true, runIOReader, &data) < 0) {
+        virReportSystemError(errno, "%s", _("Unable to create reader thread"));
+        goto cleanup;
+    }
+    haveReader = true;
+
     while (1) {
+        runIOBuffer *buf;
         ssize_t got;
 
-        /* If we read with O_DIRECT from file we can't use saferead as
-         * it can lead to unaligned read after reading last bytes.
-         * If we write with O_DIRECT use should use saferead so that
-         * writes will be aligned.
-         * In other cases using saferead reduces number of syscalls.
-         */
-        if (fdin == fd && direct) {
-            if ((got = read(fdin, buf, buflen)) < 0 &&
-                errno == EINTR)
-                continue;
-        } else {
-            got = saferead(fdin, buf, buflen);
-        }
+        virMutexLock(&data.lock);
+        while (data.count == 0)
+            ignore_value(virCondWait(&data.cond, &data.lock));
+        buf = &data.bufs[data.tail];
+        virMutexUnlock(&data.lock);
 
-        if (got < 0) {
-            virReportSystemError(errno, _("Unable to read %s"), fdinname);
-            goto cleanup;
-        }
-        if (got == 0)
+        if ((got = buf->len) == 0)
             break;
 
         total += got;
 
         /* handle last write size align in direct case */
-        if (got < buflen && direct && fdout == fd) {
+        if (got < data.buflen && direct && fdout == fd) {
             ssize_t aligned_got = (got + alignMask) & ~alignMask;
 
-            memset(buf + got, 0, aligned_got - got);
+            memset(buf->buf + got, 0, aligned_got - got);
 
-            if (safewrite(fdout, buf, aligned_got) < 0) {
+            if (safewrite(fdout, buf->buf, aligned_got) < 0) {
                 virReportSystemError(errno, _("Unable to write %s"), fdoutname);
                 goto cleanup;
             }
@@ -147,10 +336,35 @@ runIO(const char *path, int fd, int oflags)
             break;
         }
 
-        if (safewrite(fdout, buf, got) < 0) {
+        if (sparse && runIOBufferIsZero(buf->buf, got)) {
+            if (lseek(fdout, got, SEEK_CUR) < 0) {
+                virReportSystemError(errno, _("Unable to seek %s"), fdoutname);
+                goto cleanup;
+            }
+        } else if (safewrite(fdout, buf->buf, got) < 0) {
             virReportSystemError(errno, _("Unable to write %s"), fdoutname);
             goto cleanup;
         }
+
+        virMutexLock(&data.lock);
+        data.tail = (data.tail + 1) % IOHELPER_NBUFFERS;
+        data.count--;
+        virCondSignal(&data.cond);
+        virMutexUnlock(&data.lock);
+    }
+
+    runIOReaderStop(&data, &reader);
+    haveReader = false;
+
+    if (data.readErrno) {
+        virReportSystemError(data.readErrno, _("Unable to read %s"), fdinname);
+        goto cleanup;
+    }
+
+    /* Trailing zeroes were skipped rather than written */
+    if (sparse && ftruncate(fd, total) < 0) {
+        virReportSystemError(errno, _("Unable to truncate %s"), fdoutname);
+        goto cleanup;
     }
 
     /* Ensure all data is written */
@@ -165,6 +379,16 @@ runIO(const char *path, int fd, int oflags)
     ret = 0;
 
  cleanup:
+    if (haveReader)
+        runIOReaderStop(&data, &reader);
+    VIR_FORCE_CLOSE(data.wakeupfd[0]);
+    VIR_FORCE_CLOSE(data.wakeupfd[1]);
+    if (haveCond)
+        virCondDestroy(&data.cond);
+    if (haveLock)
+        virMutexDestroy(&data.lock);
+    for (i = 0; i < IOHELPER_NBUFFERS; i++)
+        VIR_FREE(data.bufs[i].base);
     if (VIR_CLOSE(fd) < 0 &&
         ret == 0) {
         virReportSystemError(errno, _("Unable to close %s"), path);
@@ -411,39 +411,28 @@ char *
 virBitmapFormat(virBitmapPtr bitmap)
 {
     virBuffer buf = VIR_BUFFER_INITIALIZER;
-    bool first = true;
-    int start, cur, prev;
+    ssize_t start;
+    ssize_t end;
 
-    if (!bitmap || (cur = virBitmapNextSetBit(bitmap, -1)) < 0) {
-        char *ret;
-        ret = g_strdup("");
-        return ret;
-    }
-
-    start = prev = cur;
-    while (prev >= 0) {
-        cur = virBitmapNextSetBit(bitmap, prev);
+    if (!bitmap || (start = virBitmapNextSetBit(bitmap, -1)) < 0)
+        return g_strdup("");
 
-        if (cur == prev + 1) {
-            prev = cur;
-            continue;
-        }
-
-        /* cur < 0 or cur > prev + 1 */
+    /* Both searches skip whole words, so long runs of set or clear bits
+     * are found without visiting every bit in them. */
+    while (start >= 0) {
+        if ((end = virBitmapNextClearBit(bitmap, start)) < 0)
+            end = bitmap->nbits;
 
-        if (!first)
-            virBufferAddLit(&buf, ",");
+        if (end - 1 == start)
+            virBufferAsprintf(&buf, "%zd,", start);
         else
-            first = false;
+            virBufferAsprintf(&buf, "%zd-%zd,", start, end - 1);
 
-        if (prev == start)
-            virBufferAsprintf(&buf, "%d", start);
-        else
-            virBufferAsprintf(&buf, "%d-%d", start, prev);
-
-        start = prev = cur;
+        start = virBitmapNextSetBit(bitmap, end);
     }
 
+    virBufferTrim(&buf, ",", -1);
+
     return virBufferContentAndReset(&buf);
 }
 
@@ -1034,7 +1023,6 @@ virBitmapNextSetBit(virBitmapPtr bitmap,
 ssize_t
 virBitmapLastSetBit(virBitmapPtr bitmap)
 {
-    ssize_t i;
     int unusedBits;
     ssize_t sz;
     unsigned long bits;
@@ -1064,12 +1052,8 @@ virBitmapLastSetBit(virBitmapPtr bitmap)
     return -1;
 
  found:
-    for (i = VIR_BITMAP_BITS_PER_UNIT - 1; i >= 0; i--) {
-        if (bits & 1UL << i)
-            return i + sz * VIR_BITMAP_BITS_PER_UNIT;
-    }
-
-    return -1;
+    return VIR_BITMAP_BITS_PER_UNIT - 1 - __builtin_clzl(bits) +
+           sz * VIR_BITMAP_BITS_PER_UNIT;
 }
 
 
@@ -329,6 +329,50 @@ virBufferVasprintf(virBufferPtr buf, const char *format, va_list argptr)
 }
 
 
+/* Replacements of characters when escaping strings for XML. Characters
+ * without an entry are copied as they are. Control characters, which
+ * are not allowed in XML, map to an empty string and are dropped. Note
+ * that character over 0x80 are likely to give problem with UTF-8 XML,
+ * but since our string don't have an encoding it's hard to handle
+ * properly we have to assume it's UTF-8 too. */
+static const char *const virBufferXMLEscapes[256] = {
+    [0x01] = "", [0x02] = "", [0x03] = "", [0x04] = "",
+    [0x05] = "", [0x06] = "", [0x07] = "", [0x08] = "",
+    /* \t, \n */
+    [0x0B] = "", [0x0C] = "",
+    /* \r */
+    [0x0E] = "", [0x0F] = "", [0x10] = "", [0x11] = "",
+    [0x12] = "", [0x13] = "", [0x14] = "", [0x15] = "",
+    [0x16] = "", [0x17] = "", [0x18] = "", [0x19] = "",
+    ['"'] = "&quot;",
+    ['&'] = "&amp;",
+    ['\''] = "&apos;",
+    ['<'] = "&lt;",
+    ['>'] = "&gt;",
+};
+
+
+static void
+virBufferXMLEscapeAppend(GString *out, const char *str)
+{
+    const char *cur;
+    const char *run = str;
+
+    for (cur = str; *cur; cur++) {
+        const char *rep = virBufferXMLEscapes[(unsigned char) *cur];
+
+        if (!rep)
+            continue;
+
+        g_string_append_len(out, run, cur - run);
+        g_string_append(out, rep);
+        run = cur + 1;
+    }
+
+    g_string_append_len(out, run, cur - run);
+}
+
+
 /**
  * virBufferEscapeString:
  * @buf: the buffer to append to
@@ -343,78 +387,32 @@ virBufferVasprintf(virBufferPtr buf, const char *format, va_list argptr)
 void
 virBufferEscapeString(virBufferPtr buf, const char *format, const char *str)
 {
-    int len;
-    g_autofree char *escaped = NULL;
-    char *out;
-    const char *cur;
-    const char forbidden_characters[] = {
-        0x01,   0x02,   0x03,   0x04,   0x05,   0x06,   0x07,   0x08,
-        /*\t*/  /*\n*/  0x0B,   0x0C,   /*\r*/  0x0E,   0x0F,   0x10,
-        0x11,   0x12,   0x13,   0x14,   0x15,   0x16,   0x17,   0x18,
-        0x19,   '"',    '&',    '\'',   '<',    '>',
-        '\0'
-    };
+    const char *arg;
+    GString *escaped;
 
     if ((format == NULL) || (buf == NULL) || (str == NULL))
         return;
 
-    len = strlen(str);
-    if (strcspn(str, forbidden_characters) == len) {
-        virBufferAsprintf(buf, format, str);
+    /* Nearly all callers use a format with the %s as the only conversion.
+     * Copy the text around it directly and escape @str straight into the
+     * buffer rather than going through a temporary string and printf. */
+    if ((arg = strstr(format, "%s")) &&
+        !memchr(format, '%', arg - format) &&
+        !strchr(arg + 2, '%')) {
+        virBufferInitialize(buf);
+        virBufferApplyIndent(buf);
+
+        g_string_append_len(buf->str, format, arg - format);
+        virBufferXMLEscapeAppend(buf->str, str);
+        g_string_append(buf->str, arg + 2);
         return;
     }
 
-    escaped = g_malloc0_n(len + 1, 6);
-
-    cur = str;
-    out = escaped;
-    while (*cur != 0) {
-        if (*cur == '<') {
-            *out++ = '&';
-            *out++ = 'l';
-            *out++ = 't';
-            *out++ = ';';
-        } else if (*cur == '>') {
-            *out++ = '&';
-            *out++ = 'g';
-            *out++ = 't';
-            *out++ = ';';
-        } else if (*cur == '&') {
-            *out++ = '&';
-            *out++ = 'a';
-            *out++ = 'm';
-            *out++ = 'p';
-            *out++ = ';';
-        } else if (*cur == '"') {
-            *out++ = '&';
-            *out++ = 'q';
-            *out++ = 'u';
-            *out++ = 'o';
-            *out++ = 't';
-            *out++ = ';';
-        } else if (*cur == '\'') {
-            *out++ = '&';
-            *out++ = 'a';
-            *out++ = 'p';
-            *out++ = 'o';
-            *out++ = 's';
-            *out++ = ';';
-        } else if (!strchr(forbidden_characters, *cur)) {
-            /*
-             * default case, just copy !
-             * Note that character over 0x80 are likely to give problem
-             * with UTF-8 XML, but since our string don't have an encoding
-             * it's hard to handle properly we have to assume it's UTF-8 too
-             */
-            *out++ = *cur;
-        } else {
-            /* silently ignore control characters */
-        }
-        cur++;
-    }
-    *out = 0;
+    escaped = g_string_sized_new(strlen(str));
+    virBufferXMLEscapeAppend(escaped, str);
 
-    virBufferAsprintf(buf, format, escaped);
+    virBufferAsprintf(buf, format, escaped->str);
+    g_string_free(escaped, TRUE);
 }
 
 /**
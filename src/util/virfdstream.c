@@ -103,6 +103,11 @@ struct virFDStreamData {
     virFDStreamInternalCloseCbFreeOpaque icbFreeOpaque;
     void *icbOpaque;
 
+    /* internal callback waiting for the other end of the FD on close */
+    virFDStreamInternalFinishCb ifcbCb;
+    virFDStreamInternalCloseCbFreeOpaque ifcbFreeOpaque;
+    void *ifcbOpaque;
+
     /* Thread data */
     virThreadPtr thread;
     virCond threadCond;
@@ -111,8 +116,17 @@ struct virFDStreamData {
     bool threadAbort;
     bool threadDoRead;
     virFDStreamMsgPtr msg;
+    size_t nmsgs;       /* number of messages in the @msg queue */
 };
 
+/* Size of data chunks the worker thread reads from the file */
+#define VIR_FDSTREAM_THREAD_BUFLEN (1024 * 1024)
+
+/* How many chunks the worker thread may read ahead of the stream
+ * consumer. Keeps the disk busy while the previous chunk is being
+ * transferred over the connection. */
+#define VIR_FDSTREAM_THREAD_READAHEAD 4
+
 static virClassPtr virFDStreamDataClass;
 
 static void virFDStreamMsgQueueFree(virFDStreamMsgPtr *queue);
@@ -151,6 +165,7 @@ virFDStreamMsgQueuePush(virFDStreamDataPtr fdst,
         tmp = &(*tmp)->next;
 
     *tmp = msg;
+    fdst->nmsgs++;
     virCondSignal(&fdst->threadCond);
 
     if (safewrite(fd, &c, sizeof(c)) != sizeof(c)) {
@@ -175,6 +190,7 @@ virFDStreamMsgQueuePop(virFDStreamDataPtr fdst,
     if (tmp) {
         fdst->msg = tmp->next;
         tmp->next = NULL;
+        fdst->nmsgs--;
     }
 
     virCondSignal(&fdst->threadCond);
@@ -434,8 +450,17 @@ virFDStreamThreadDoRead(virFDStreamDataPtr fdst,
     char *buf = NULL;
     ssize_t got;
 
+    /* The object lock is released while doing I/O on the file so that
+     * the stream consumer can pick up already queued chunks meanwhile.
+     * The input FD is owned by this thread, nobody else touches it. */
     if (sparse && *dataLen == 0) {
-        if (virFileInData(fdin, &inData, &sectionLen) < 0)
+        int rc;
+
+        virObjectUnlock(fdst);
+        rc = virFileInData(fdin, &inData, &sectionLen);
+        virObjectLock(fdst);
+
+        if (rc < 0)
             goto error;
 
         if (length &&
@@ -475,7 +500,11 @@ virFDStreamThreadDoRead(virFDStreamDataPtr fdst,
         if (VIR_ALLOC_N(buf, buflen) < 0)
             goto error;
 
-        if ((got = saferead(fdin, buf, buflen)) < 0) {
+        virObjectUnlock(fdst);
+        got = saferead(fdin, buf, buflen);
+        virObjectLock(fdst);
+
+        if (got < 0) {
             virReportSystemError(errno,
                                  _("Unable to read %s"),
                                  fdinname);
@@ -517,9 +546,14 @@ virFDStreamThreadDoWrite(virFDStreamDataPtr fdst,
 
     switch (msg->type) {
     case VIR_FDSTREAM_MSG_TYPE_DATA:
+        /* Only this thread ever pops the head of the queue, so @msg stays
+         * valid while the stream producer appends more data to the queue
+         * and the object lock can be dropped for the write. */
+        virObjectUnlock(fdst);
         got = safewrite(fdout,
                         msg->stream.data.buf + msg->stream.data.offset,
                         msg->stream.data.len - msg->stream.data.offset);
+        virObjectLock(fdst);
         if (got < 0) {
             virReportSystemError(errno,
                                  _("Unable to write %s"),
@@ -581,7 +615,7 @@ virFDStreamThread(void *opaque)
     char *fdoutname = data->fdoutname;
     virFDStreamDataPtr fdst = st->privateData;
     bool doRead = fdst->threadDoRead;
-    size_t buflen = 256 * 1024;
+    size_t buflen = VIR_FDSTREAM_THREAD_BUFLEN;
     size_t total = 0;
     size_t dataLen = 0;
 
@@ -591,7 +625,9 @@ virFDStreamThread(void *opaque)
     while (1) {
         ssize_t got;
 
-        while (doRead == (fdst->msg != NULL) &&
+        while ((doRead ?
+                fdst->nmsgs >= VIR_FDSTREAM_THREAD_READAHEAD :
+                fdst->msg == NULL) &&
                !fdst->threadQuit) {
             if (virCondWait(&fdst->threadCond, &fdst->parent.lock)) {
                 virReportSystemError(errno, "%s",
@@ -726,6 +762,21 @@ virFDStreamCloseInt(virStreamPtr st, bool streamAbort)
         virReportSystemError(errno, "%s",
                              _("Unable to close"));
 
+    /* the other end of the FD sees EOF now, wait for it to finish */
+    if (fdst->ifcbCb) {
+        virObjectUnlock(fdst);
+        if ((fdst->ifcbCb)(st, streamAbort, fdst->ifcbOpaque) < 0 &&
+            !streamAbort)
+            ret = -1;
+        virObjectLock(fdst);
+
+        if (fdst->ifcbFreeOpaque)
+            (fdst->ifcbFreeOpaque)(fdst->ifcbOpaque);
+        fdst->ifcbCb = NULL;
+        fdst->ifcbFreeOpaque = NULL;
+        fdst->ifcbOpaque = NULL;
+    }
+
     st->privateData = NULL;
 
     /* call the internal stream closing callback */
@@ -1446,3 +1497,36 @@ int virFDStreamSetInternalCloseCb(virStreamPtr st,
     virObjectUnlock(fdst);
     return 0;
 }
+
+
+/**
+ * virFDStreamSetInternalFinishCb:
+ * @st: stream opened by virFDStreamOpen
+ * @cb: callback to wait for the other end of the stream's FD
+ * @opaque: data passed to @cb
+ * @fcb: function freeing @opaque
+ *
+ * Lets the stream wait for a thread serving the other end of a pipe or
+ * socket when it is closed. Closing or finishing the stream then fails if
+ * @cb reports an error, so that errors of the thread are not lost. Errors
+ * reported by @cb when the stream is aborted are ignored.
+ */
+int virFDStreamSetInternalFinishCb(virStreamPtr st,
+                                   virFDStreamInternalFinishCb cb,
+                                   void *opaque,
+                                   virFDStreamInternalCloseCbFreeOpaque fcb)
+{
+    virFDStreamDataPtr fdst = st->privateData;
+
+    virObjectLock(fdst);
+
+    if (fdst->ifcbFreeOpaque)
+        (fdst->ifcbFreeOpaque)(fdst->ifcbOpaque);
+
+    fdst->ifcbCb = cb;
+    fdst->ifcbOpaque = opaque;
+    fdst->ifcbFreeOpaque = fcb;
+
+    virObjectUnlock(fdst);
+    return 0;
+}
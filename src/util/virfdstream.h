@@ -29,6 +29,13 @@ typedef void (*virFDStreamInternalCloseCb)(virStreamPtr st, void *opaque);
 
 typedef void (*virFDStreamInternalCloseCbFreeOpaque)(void *opaque);
 
+/* internal callback called on closing the stream right after the FD was
+ * closed, to wait for the process or thread at the other end of the FD,
+ * returns -1 with an error reported if it failed */
+typedef int (*virFDStreamInternalFinishCb)(virStreamPtr st,
+                                           bool streamAbort,
+                                           void *opaque);
+
 
 int virFDStreamOpen(virStreamPtr st,
                     int fd);
@@ -64,3 +71,7 @@ int virFDStreamSetInternalCloseCb(virStreamPtr st,
                                   virFDStreamInternalCloseCb cb,
                                   void *opaque,
                                   virFDStreamInternalCloseCbFreeOpaque fcb);
+int virFDStreamSetInternalFinishCb(virStreamPtr st,
+                                   virFDStreamInternalFinishCb cb,
+                                   void *opaque,
+                                   virFDStreamInternalCloseCbFreeOpaque fcb);
@@ -24,6 +24,7 @@
 
 #include <unistd.h>
 #include <fcntl.h>
+#include "stat-time.h"
 #include "viralloc.h"
 #include "virxml.h"
 #include "viruuid.h"
@@ -40,6 +41,7 @@
 #include "virjson.h"
 #include "virstorageencryption.h"
 #include "virsecret.h"
+#include "virthread.h"
 
 #define VIR_FROM_THIS VIR_FROM_STORAGE
 
@@ -4898,6 +4900,167 @@ virStorageFileReportBrokenChain(int errcode,
 }
 
 
+/* Process wide cache of image headers of local files, so that walking the
+ * same backing chain again (on every domain start, snapshot, block job, ...)
+ * doesn't have to open and read every image in the chain. Entries are keyed
+ * by the user and group the image is accessed as and its unique identifier,
+ * so that a header read with one set of credentials is never handed out to
+ * another. They are valid only as long as the file still has the same
+ * identity, size and timestamps. */
+#define VIR_STORAGE_FILE_HEADER_CACHE_MAX 4096
+
+/* Files modified less than this long ago are not cached, because a
+ * subsequent change might not be visible in the coarse grained
+ * timestamps. */
+#define VIR_STORAGE_FILE_HEADER_CACHE_SETTLE_NS (2 * 1000000000LL)
+
+typedef struct _virStorageFileHeaderCacheEntry virStorageFileHeaderCacheEntry;
+typedef virStorageFileHeaderCacheEntry *virStorageFileHeaderCacheEntryPtr;
+struct _virStorageFileHeaderCacheEntry {
+    unsigned long long dev;
+    unsigned long long ino;
+    unsigned long long size;
+    long long mtime; /* in nanoseconds */
+    long long ctime; /* in nanoseconds */
+
+    char *buf;
+    ssize_t len;
+};
+
+static virMutex virStorageFileHeaderCacheLock = VIR_MUTEX_INITIALIZER;
+static virHashTablePtr virStorageFileHeaderCache;
+
+
+static void
+virStorageFileHeaderCacheEntryFree(void *opaque)
+{
+    virStorageFileHeaderCacheEntryPtr entry = opaque;
+
+    if (!entry)
+        return;
+
+    VIR_FREE(entry->buf);
+    VIR_FREE(entry);
+}
+
+
+static void
+virStorageFileHeaderCacheEntrySetStamp(virStorageFileHeaderCacheEntryPtr entry,
+                                       const struct stat *sb)
+{
+    struct timespec mt = get_stat_mtime(sb);
+    struct timespec ct = get_stat_ctime(sb);
+
+    entry->dev = sb->st_dev;
+    entry->ino = sb->st_ino;
+    entry->size = sb->st_size;
+    entry->mtime = mt.tv_sec * 1000000000LL + mt.tv_nsec;
+    entry->ctime = ct.tv_sec * 1000000000LL + ct.tv_nsec;
+}
+
+
+/**
+ * virStorageFileReadHeader:
+ * @src: storage file to read the header of
+ * @uniqueName: unique identifier of @src
+ * @buf: filled with the header (to be freed by the caller)
+ *
+ * Reads up to VIR_STORAGE_MAX_HEADER bytes from the beginning of @src. For
+ * local regular files the header is served from a process wide cache as
+ * long as the file did not change since it was read last by the same
+ * user and group @src is accessed as.
+ *
+ * Returns the length of the header on success, -1 on failure and -2 if
+ * reading is not supported for @src. Libvirt error is reported on failure.
+ */
+static ssize_t
+virStorageFileReadHeader(virStorageSourcePtr src,
+                         const char *uniqueName,
+                         char **buf)
+{
+    virStorageFileHeaderCacheEntryPtr entry = NULL;
+    virStorageFileHeaderCacheEntry stamp = { 0 };
+    g_autofree char *key = NULL;
+    struct stat sb;
+    ssize_t len;
+
+    if (virStorageSourceGetActualType(src) != VIR_STORAGE_TYPE_FILE ||
+        virStorageFileStat(src, &sb) < 0 ||
+        !S_ISREG(sb.st_mode))
+        return virStorageFileRead(src, 0, VIR_STORAGE_MAX_HEADER, buf);
+
+    virStorageFileHeaderCacheEntrySetStamp(&stamp, &sb);
+
+    /* The backend has already resolved -1 to the effective IDs */
+    key = g_strdup_printf("%u:%u:%s",
+                          (unsigned int) src->drv->uid,
+                          (unsigned int) src->drv->gid,
+                          uniqueName);
+
+    virMutexLock(&virStorageFileHeaderCacheLock);
+    if (virStorageFileHeaderCache &&
+        (entry = virHashLookup(virStorageFileHeaderCache, key))) {
+        if (entry->dev == stamp.dev &&
+            entry->ino == stamp.ino &&
+            entry->size == stamp.size &&
+            entry->mtime == stamp.mtime &&
+            entry->ctime == stamp.ctime) {
+            *buf = g_new0(char, entry->len);
+            memcpy(*buf, entry->buf, entry->len);
+            len = entry->len;
+            virMutexUnlock(&virStorageFileHeaderCacheLock);
+
+            VIR_DEBUG("using cached header of '%s'", key);
+            return len;
+        }
+
+        ignore_value(virHashRemoveEntry(virStorageFileHeaderCache, key));
+    }
+    virMutexUnlock(&virStorageFileHeaderCacheLock);
+
+    /* The file was stat()-ed before reading it. Should it change meanwhile,
+     * the cached entry won't match the next time and is simply replaced. */
+    if ((len = virStorageFileRead(src, 0, VIR_STORAGE_MAX_HEADER, buf)) < 0)
+        return len;
+
+    /* Empty headers are not worth caching, which also keeps the
+     * allocations below (and on a hit) non-empty. */
+    if (len == 0 ||
+        g_get_real_time() * 1000LL - MAX(stamp.mtime, stamp.ctime) <
+        VIR_STORAGE_FILE_HEADER_CACHE_SETTLE_NS)
+        return len;
+
+    entry = g_new0(virStorageFileHeaderCacheEntry, 1);
+    *entry = stamp;
+    entry->buf = g_new0(char, len);
+    memcpy(entry->buf, *buf, len);
+    entry->len = len;
+
+    virMutexLock(&virStorageFileHeaderCacheLock);
+    if (!virStorageFileHeaderCache)
+        virStorageFileHeaderCache = virHashCreate(32, virStorageFileHeaderCacheEntryFree);
+
+    if (virStorageFileHeaderCache) {
+        /* Keep the memory usage bounded. Chains of running domains are
+         * repopulated on their next walk. */
+        if (virHashSize(virStorageFileHeaderCache) >= VIR_STORAGE_FILE_HEADER_CACHE_MAX)
+            virHashRemoveAll(virStorageFileHeaderCache);
+
+        if (virHashUpdateEntry(virStorageFileHeaderCache, key, entry) == 0)
+            entry = NULL;
+    }
+    virMutexUnlock(&virStorageFileHeaderCacheLock);
+
+    if (entry) {
+        /* Caching is best effort, don't fail the lookup because of it */
+        virStorageFileHeaderCacheEntryFree(entry);
+        virResetLastError();
+    }
+
+    return len;
+}
+
+
 /* Recursive workhorse for virStorageFileGetMetadata.  */
 static int
 virStorageFileGetMetadataRecurse(virStorageSourcePtr src,
@@ -4945,8 +5108,7 @@ virStorageFileGetMetadataRecurse(virStorageSourcePtr src,
     if (virHashAddEntry(cycle, uniqueName, (void *)1) < 0)
         goto cleanup;
 
-    if ((headerLen = virStorageFileRead(src, 0, VIR_STORAGE_MAX_HEADER,
-                                        &buf)) < 0) {
+    if ((headerLen = virStorageFileReadHeader(src, uniqueName, &buf)) < 0) {
         if (headerLen == -2)
             virReportError(VIR_ERR_INTERNAL_ERROR,
                            _("storage file reading is not supported for "
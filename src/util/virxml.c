@@ -26,6 +26,8 @@
 
 #include <libxml/xpathInternals.h>
 
+#include "stat-time.h"
+
 #include "virerror.h"
 #include "virxml.h"
 #include "virbuffer.h"
@@ -33,6 +35,8 @@
 #include "viralloc.h"
 #include "virfile.h"
 #include "virstring.h"
+#include "virhash.h"
+#include "virthread.h"
 
 #define VIR_FROM_THIS VIR_FROM_XML
 
@@ -1323,22 +1327,215 @@ virXMLValidatorValidate(virXMLValidatorPtr validator,
 }
 
 
+/* Compiling a schema is several times more expensive than validating a
+ * document against it, so compiled schemas are kept around for the
+ * lifetime of the process. Every validation uses its own validation
+ * context, so documents can be validated against the same schema in
+ * parallel. Schemas include other files from their directory (e.g.
+ * domain.rng includes domaincommon.rng), so a schema is compiled again
+ * whenever any schema file in that directory was replaced or changed,
+ * e.g. by a package update. */
+typedef struct _virXMLSchemaCacheEntry virXMLSchemaCacheEntry;
+typedef virXMLSchemaCacheEntry *virXMLSchemaCacheEntryPtr;
+struct _virXMLSchemaCacheEntry {
+    unsigned long long files;
+    unsigned long long size;
+    unsigned long long ids; /* XOR of the devices and inodes of the files */
+    long long changed; /* newest mtime or ctime in nanoseconds */
+
+    xmlRelaxNGPtr rng;
+    unsigned int refs; /* the cache holds one reference */
+};
+
+/* Protects the cache and the reference counts of its entries */
+static virMutex virXMLSchemaCacheLock = VIR_MUTEX_INITIALIZER;
+static virHashTablePtr virXMLSchemaCache;
+
+
+/* Must be called with virXMLSchemaCacheLock held */
+static void
+virXMLSchemaCacheEntryUnref(void *opaque)
+{
+    virXMLSchemaCacheEntryPtr entry = opaque;
+
+    if (!entry || --entry->refs > 0)
+        return;
+
+    xmlRelaxNGFree(entry->rng);
+    VIR_FREE(entry);
+}
+
+
+static int
+virXMLSchemaCacheEntrySetStamp(virXMLSchemaCacheEntryPtr entry,
+                               const char *schemafile)
+{
+    g_autofree char *dirname = g_path_get_dirname(schemafile);
+    DIR *dir = NULL;
+    struct dirent *ent;
+    int rc;
+
+    if (virDirOpen(&dir, dirname) < 0)
+        return -1;
+
+    while ((rc = virDirRead(dir, &ent, dirname)) > 0) {
+        g_autofree char *path = NULL;
+        struct timespec mt;
+        struct timespec ct;
+        struct stat sb;
+
+        if (!virStringHasSuffix(ent->d_name, ".rng"))
+            continue;
+
+        path = g_strdup_printf("%s/%s", dirname, ent->d_name);
+        if (stat(path, &sb) < 0) {
+            virReportSystemError(errno, _("cannot stat schema '%s'"), path);
+            rc = -1;
+            break;
+        }
+
+        mt = get_stat_mtime(&sb);
+        ct = get_stat_ctime(&sb);
+
+        entry->files++;
+        entry->size += sb.st_size;
+        entry->ids ^= (unsigned long long) sb.st_dev ^ sb.st_ino;
+        entry->changed = MAX(entry->changed,
+                             MAX(mt.tv_sec * 1000000000LL + mt.tv_nsec,
+                                 ct.tv_sec * 1000000000LL + ct.tv_nsec));
+    }
+
+    VIR_DIR_CLOSE(dir);
+    return rc;
+}
+
+
+static xmlRelaxNGPtr
+virXMLSchemaCompile(const char *schemafile)
+{
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    xmlRelaxNGParserCtxtPtr parser;
+    xmlRelaxNGPtr rng;
+
+    if (!(parser = xmlRelaxNGNewParserCtxt(schemafile))) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Unable to create RNG parser for %s"),
+                       schemafile);
+        return NULL;
+    }
+
+    xmlRelaxNGSetParserErrors(parser, catchRNGError, ignoreRNGError, &buf);
+
+    if (!(rng = xmlRelaxNGParse(parser))) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Unable to parse RNG %s: %s"),
+                       schemafile, virBufferCurrentContent(&buf));
+    }
+
+    xmlRelaxNGFreeParserCtxt(parser);
+    return rng;
+}
+
+
+/**
+ * virXMLSchemaCacheGet:
+ * @schemafile: path of the schema
+ *
+ * Looks up the compiled @schemafile, compiling it if it isn't cached yet
+ * or if the schema files changed since. Only the lookup is done with the
+ * cache locked.
+ *
+ * Returns a referenced cache entry to be released with
+ * virXMLSchemaCachePut or NULL on error.
+ */
+static virXMLSchemaCacheEntryPtr
+virXMLSchemaCacheGet(const char *schemafile)
+{
+    virXMLSchemaCacheEntry stamp = { 0 };
+    virXMLSchemaCacheEntryPtr entry;
+
+    if (virXMLSchemaCacheEntrySetStamp(&stamp, schemafile) < 0)
+        return NULL;
+
+    virMutexLock(&virXMLSchemaCacheLock);
+    if (virXMLSchemaCache &&
+        (entry = virHashLookup(virXMLSchemaCache, schemafile)) &&
+        entry->files == stamp.files &&
+        entry->size == stamp.size &&
+        entry->ids == stamp.ids &&
+        entry->changed == stamp.changed) {
+        entry->refs++;
+        virMutexUnlock(&virXMLSchemaCacheLock);
+        return entry;
+    }
+    virMutexUnlock(&virXMLSchemaCacheLock);
+
+    if (!(stamp.rng = virXMLSchemaCompile(schemafile)))
+        return NULL;
+
+    entry = g_new0(virXMLSchemaCacheEntry, 1);
+    *entry = stamp;
+    entry->refs = 1;
+
+    virMutexLock(&virXMLSchemaCacheLock);
+    if (!virXMLSchemaCache)
+        virXMLSchemaCache = virHashNew(virXMLSchemaCacheEntryUnref);
+
+    /* Caching is best effort, a schema which can't be cached is used
+     * just this once */
+    if (virXMLSchemaCache &&
+        virHashUpdateEntry(virXMLSchemaCache, schemafile, entry) == 0)
+        entry->refs++;
+    else
+        virResetLastError();
+    virMutexUnlock(&virXMLSchemaCacheLock);
+
+    return entry;
+}
+
+
+static void
+virXMLSchemaCachePut(virXMLSchemaCacheEntryPtr entry)
+{
+    virMutexLock(&virXMLSchemaCacheLock);
+    virXMLSchemaCacheEntryUnref(entry);
+    virMutexUnlock(&virXMLSchemaCacheLock);
+}
+
+
 int
 virXMLValidateAgainstSchema(const char *schemafile,
                             xmlDocPtr doc)
 {
-    virXMLValidatorPtr validator = NULL;
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    virXMLSchemaCacheEntryPtr entry;
+    xmlRelaxNGValidCtxtPtr rngValid = NULL;
     int ret = -1;
 
-    if (!(validator = virXMLValidatorInit(schemafile)))
+    if (!(entry = virXMLSchemaCacheGet(schemafile)))
         return -1;
 
-    if (virXMLValidatorValidate(validator, doc) < 0)
+    if (!(rngValid = xmlRelaxNGNewValidCtxt(entry->rng))) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Unable to create RNG validation context %s"),
+                       schemafile);
+        goto cleanup;
+    }
+
+    xmlRelaxNGSetValidErrors(rngValid, catchRNGError, ignoreRNGError, &buf);
+
+    if (xmlRelaxNGValidateDoc(rngValid, doc) != 0) {
+        virReportError(VIR_ERR_XML_INVALID_SCHEMA,
+                       _("Unable to validate doc against %s\n%s"),
+                       schemafile, virBufferCurrentContent(&buf));
         goto cleanup;
+    }
 
     ret = 0;
+
  cleanup:
-    virXMLValidatorFree(validator);
+    xmlRelaxNGFreeValidCtxt(rngValid);
+    virXMLSchemaCachePut(entry);
     return ret;
 }
 
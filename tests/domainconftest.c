@@ -76,6 +76,145 @@ static int testGetFilesystem(const void *opaque)
     return ret;
 }
 
+
+/* Check the disk found by target and by alias against a plain scan */
+static int
+testDeviceLookupCheck(virDomainDefPtr def,
+                      const char *dst,
+                      const char *alias)
+{
+    virDomainDiskDefPtr expect = NULL;
+    virDomainDeviceDef dev;
+    int idx;
+    size_t i;
+
+    for (i = 0; i < def->ndisks; i++) {
+        if (STREQ(def->disks[i]->dst, dst)) {
+            expect = def->disks[i];
+            break;
+        }
+    }
+
+    idx = virDomainDiskIndexByName(def, dst, false);
+    if ((expect && (idx < 0 || def->disks[idx] != expect)) ||
+        (!expect && idx >= 0)) {
+        fprintf(stderr, "Wrong disk index %d for target '%s'\n", idx, dst);
+        return -1;
+    }
+
+    if (virDomainDiskByTarget(def, dst) != expect) {
+        fprintf(stderr, "Wrong disk for target '%s'\n", dst);
+        return -1;
+    }
+
+    if (virDomainDefFindDevice(def, alias, &dev, false) < 0) {
+        if (expect) {
+            fprintf(stderr, "Expected disk for alias '%s'\n", alias);
+            return -1;
+        }
+        virResetLastError();
+    } else if (!expect || dev.type != VIR_DOMAIN_DEVICE_DISK ||
+               dev.data.disk != expect) {
+        fprintf(stderr, "Wrong device for alias '%s'\n", alias);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static int
+testDeviceLookupCheckAll(virDomainDefPtr def)
+{
+    virDomainDeviceDef dev;
+
+    if (testDeviceLookupCheck(def, "vda", "virtio-disk0") < 0 ||
+        testDeviceLookupCheck(def, "vdb", "virtio-disk1") < 0 ||
+        testDeviceLookupCheck(def, "vdc", "virtio-disk2") < 0 ||
+        testDeviceLookupCheck(def, "sda", "scsi0-0-0-0") < 0 ||
+        testDeviceLookupCheck(def, "vdz", "virtio-disk25") < 0)
+        return -1;
+
+    if (virDomainDefFindDevice(def, "net0", &dev, false) < 0 ||
+        dev.type != VIR_DOMAIN_DEVICE_NET ||
+        dev.data.net != def->nets[0]) {
+        fprintf(stderr, "Wrong device for alias 'net0'\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/* The lookup indexes are built on first use and not updated when the
+ * device arrays change, make sure they never return stale results */
+static int
+testDeviceLookup(const void *opaque G_GNUC_UNUSED)
+{
+    int ret = -1;
+    virDomainDefPtr def = NULL;
+    virDomainDiskDefPtr disk = NULL;
+    virDomainDiskDefPtr tmp;
+    g_autofree char *filename = NULL;
+
+    filename = g_strdup_printf("%s/domainconfdata/devicelookup.xml",
+                               abs_srcdir);
+
+    if (!(def = virDomainDefParseFile(filename, xmlopt, NULL, 0)))
+        goto cleanup;
+
+    /* build the indexes */
+    if (testDeviceLookupCheckAll(def) < 0)
+        goto cleanup;
+
+    /* insert a disk in front of the others */
+    if (!(disk = virDomainDiskDefNew(xmlopt)))
+        goto cleanup;
+    disk->dst = g_strdup("sda");
+    disk->bus = VIR_DOMAIN_DISK_BUS_SCSI;
+    disk->info.alias = g_strdup("scsi0-0-0-0");
+    if (virDomainDiskInsert(def, disk) < 0)
+        goto cleanup;
+    disk = NULL;
+
+    if (testDeviceLookupCheckAll(def) < 0)
+        goto cleanup;
+
+    /* remove a disk from the middle */
+    if (!(disk = virDomainDiskRemoveByName(def, "vdb")))
+        goto cleanup;
+    virDomainDiskDefFree(disk);
+    disk = NULL;
+
+    if (testDeviceLookupCheckAll(def) < 0)
+        goto cleanup;
+
+    /* reorder them behind the back of the helpers */
+    tmp = def->disks[0];
+    def->disks[0] = def->disks[def->ndisks - 1];
+    def->disks[def->ndisks - 1] = tmp;
+
+    if (testDeviceLookupCheckAll(def) < 0)
+        goto cleanup;
+
+    /* rename a disk in place */
+    if (!(tmp = virDomainDiskByTarget(def, "vdc")))
+        goto cleanup;
+    VIR_FREE(tmp->info.alias);
+    tmp->info.alias = g_strdup("ua-renamed");
+
+    if (testDeviceLookupCheck(def, "vdc", "ua-renamed") < 0 ||
+        testDeviceLookupCheck(def, "vdz", "virtio-disk2") < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    virDomainDiskDefFree(disk);
+    virDomainDefFree(def);
+    return ret;
+}
+
 static int
 mymain(void)
 {
@@ -103,6 +242,9 @@ mymain(void)
     DO_TEST_GET_FS("/dev/pts", false);
     DO_TEST_GET_FS("/doesnotexist", false);
 
+    if (virTestRun("Device lookup", testDeviceLookup, NULL) < 0)
+        ret = -1;
+
     virObjectUnref(caps);
     virObjectUnref(xmlopt);
 
@@ -13,6 +13,7 @@
 # include "qemu/qemu_conf.h"
 # include "qemu/qemu_domain.h"
 # include "testutilsqemu.h"
+# include "virfile.h"
 # include "virstring.h"
 
 # define VIR_FROM_THIS VIR_FROM_NONE
@@ -121,14 +122,188 @@ testCompareXMLToXMLHelper(const void *data)
 }
 
 
+static virDomainObjPtr
+testSnapshotMetadataDomain(virDomainDefPtr def)
+{
+    virDomainObjPtr vm;
+
+    if (!(vm = virDomainObjNew(driver.xmlopt)))
+        return NULL;
+
+    if (!(vm->def = virDomainDefCopy(def, driver.xmlopt, NULL, false))) {
+        virDomainObjEndAPI(&vm);
+        return NULL;
+    }
+
+    return vm;
+}
+
+
+/* Save the snapshot metadata in @data, load it again as the daemon does on
+ * startup and make sure the domain definitions can still be used and
+ * written back although they were not parsed when loading it. */
+static int
+testSnapshotMetadata(const void *data)
+{
+    const struct testInfo *info = data;
+    unsigned int parseflags = VIR_DOMAIN_SNAPSHOT_PARSE_REDEFINE |
+                              VIR_DOMAIN_SNAPSHOT_PARSE_DISKS |
+                              VIR_DOMAIN_SNAPSHOT_PARSE_INTERNAL;
+    g_autofree char *inXmlData = NULL;
+    g_autofree char *expect = NULL;
+    g_autofree char *snapFile = NULL;
+    g_autofree char *written = NULL;
+    g_autofree char *rewritten = NULL;
+    g_autofree char *domainXML = NULL;
+    g_autofree char *revertXML = NULL;
+    g_autoptr(virDomainDef) config = NULL;
+    virDomainSnapshotDefPtr def = NULL;
+    virDomainSnapshotDefPtr loaded = NULL;
+    virDomainObjPtr vm = NULL;
+    virDomainObjPtr restarted = NULL;
+    virDomainMomentObjPtr snap;
+    bool cur = false;
+    int ret = -1;
+
+    mocktime = 0;
+
+    if (virTestLoadFile(info->inxml, &inXmlData) < 0)
+        goto cleanup;
+
+    if (!(def = virDomainSnapshotDefParseString(inXmlData, driver.xmlopt,
+                                                NULL, &cur, parseflags)))
+        goto cleanup;
+
+    if (!(vm = testSnapshotMetadataDomain(def->parent.dom)))
+        goto cleanup;
+
+    if (!(expect = virDomainSnapshotDefFormat(info->uuid, def, driver.xmlopt,
+                                              VIR_DOMAIN_SNAPSHOT_FORMAT_SECURE |
+                                              VIR_DOMAIN_SNAPSHOT_FORMAT_INTERNAL |
+                                              VIR_DOMAIN_SNAPSHOT_FORMAT_CURRENT)))
+        goto cleanup;
+
+    if (!(snap = virDomainSnapshotAssignDef(vm->snapshots, def)))
+        goto cleanup;
+    def = NULL;
+    virDomainSnapshotSetCurrent(vm->snapshots, snap);
+
+    /* The saved metadata embeds the full domain definition */
+    if (qemuDomainSnapshotWriteMetadata(vm, snap, driver.xmlopt,
+                                        driver.config->snapshotDir) < 0)
+        goto cleanup;
+
+    snapFile = g_strdup_printf("%s/%s/%s.xml", driver.config->snapshotDir,
+                               vm->def->name, snap->def->name);
+    if (virTestLoadFile(snapFile, &written) < 0)
+        goto cleanup;
+
+    if (!virStringHasSuffix(written, expect)) {
+        virTestDifference(stderr, expect, written);
+        goto cleanup;
+    }
+
+    /* Loading it on startup leaves the domain definitions for later */
+    if (!(restarted = testSnapshotMetadataDomain(vm->def)))
+        goto cleanup;
+
+    if (!(loaded = virDomainSnapshotDefParseString(written, driver.xmlopt,
+                                                   NULL, &cur,
+                                                   parseflags |
+                                                   VIR_DOMAIN_SNAPSHOT_PARSE_DEFER_DOMAIN)))
+        goto cleanup;
+
+    if (!(snap = virDomainSnapshotAssignDef(restarted->snapshots, loaded))) {
+        virObjectUnref(loaded);
+        goto cleanup;
+    }
+    if (cur)
+        virDomainSnapshotSetCurrent(restarted->snapshots, snap);
+
+    if (snap->def->dom || !loaded->domainDeferred) {
+        VIR_TEST_DEBUG("domain definition was parsed on load");
+        goto cleanup;
+    }
+
+    /* Reverting to the snapshot gets the definition back */
+    if (qemuDomainSnapshotLoadDomains(&driver, restarted, snap) < 0)
+        goto cleanup;
+
+    if (!snap->def->dom || loaded->domainDeferred) {
+        VIR_TEST_DEBUG("domain definition was not loaded");
+        goto cleanup;
+    }
+
+    if (!(config = virDomainDefCopy(snap->def->dom, driver.xmlopt, NULL, false)))
+        goto cleanup;
+
+    if (!(domainXML = virDomainDefFormat(vm->def, driver.xmlopt,
+                                         VIR_DOMAIN_DEF_FORMAT_SECURE)) ||
+        !(revertXML = virDomainDefFormat(config, driver.xmlopt,
+                                         VIR_DOMAIN_DEF_FORMAT_SECURE)))
+        goto cleanup;
+
+    if (STRNEQ(domainXML, revertXML)) {
+        virTestDifference(stderr, domainXML, revertXML);
+        goto cleanup;
+    }
+
+    /* Updating the metadata of an unloaded snapshot keeps the definition */
+    qemuDomainSnapshotUnloadDomains(snap);
+
+    if (snap->def->dom || !loaded->domainDeferred) {
+        VIR_TEST_DEBUG("domain definition was not unloaded");
+        goto cleanup;
+    }
+
+    if (qemuDomainSnapshotWriteMetadata(restarted, snap, driver.xmlopt,
+                                        driver.config->snapshotDir) < 0)
+        goto cleanup;
+
+    if (virTestLoadFile(snapFile, &rewritten) < 0)
+        goto cleanup;
+
+    if (STRNEQ(written, rewritten)) {
+        virTestDifference(stderr, written, rewritten);
+        goto cleanup;
+    }
+
+    if (snap->def->dom || !loaded->domainDeferred) {
+        VIR_TEST_DEBUG("domain definition was left loaded");
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    if (snapFile)
+        unlink(snapFile);
+    virObjectUnref(def);
+    virDomainObjEndAPI(&vm);
+    virDomainObjEndAPI(&restarted);
+    return ret;
+}
+
+
+# define SNAPSHOTDIRTEMPLATE abs_builddir "/qemusnapshotdir-XXXXXX"
+
 static int
 mymain(void)
 {
     int ret = 0;
+    char snapshotdir[] = SNAPSHOTDIRTEMPLATE;
 
     if (qemuTestDriverInit(&driver) < 0)
         return EXIT_FAILURE;
 
+    if (!g_mkdtemp(snapshotdir)) {
+        fprintf(stderr, "Cannot create qemusnapshotdir");
+        return EXIT_FAILURE;
+    }
+
+    VIR_FREE(driver.config->snapshotDir);
+    driver.config->snapshotDir = g_strdup(snapshotdir);
+
     virDomainXMLOptionSetMomentPostParse(driver.xmlopt,
                                          testSnapshotPostParse);
 
@@ -188,6 +363,22 @@ mymain(void)
     DO_TEST_IN("description_only", NULL);
     DO_TEST_IN("name_only", NULL);
 
+# define DO_TEST_METADATA(name, uuid) \
+    do { \
+        const struct testInfo info = {abs_srcdir "/qemudomainsnapshotxml2xmlout/" \
+                                      name ".xml", NULL, uuid, 0, 0}; \
+        if (virTestRun("SNAPSHOT metadata " name, \
+                       testSnapshotMetadata, &info) < 0) \
+            ret = -1; \
+    } while (0)
+
+    DO_TEST_METADATA("full_domain", "c7a5fdbd-edaf-9455-926a-d65c16db1809");
+    DO_TEST_METADATA("disk_snapshot_redefine",
+                     "c7a5fdbd-edaf-9455-926a-d65c16db1809");
+
+    if (getenv("LIBVIRT_SKIP_CLEANUP") == NULL)
+        virFileDeleteTree(snapshotdir);
+
     qemuTestDriverFree(&driver);
 
     return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
@@ -0,0 +1,258 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "testutils.h"
+#include "qemu/qemu_migration_params.h"
+#define LIBVIRT_QEMU_MIGRATIONPRIV_H_ALLOW
+#include "qemu/qemu_migrationpriv.h"
+#define LIBVIRT_QEMU_MIGRATION_PARAMSPRIV_H_ALLOW
+#include "qemu/qemu_migration_paramspriv.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+#define MAX_MIRRORS 4
+
+typedef struct _qemuMigrationSharesData qemuMigrationSharesData;
+struct _qemuMigrationSharesData {
+    unsigned long long speed;
+    size_t nmirrors;
+    unsigned long long remaining[MAX_MIRRORS];
+    unsigned long long expected[MAX_MIRRORS];
+};
+
+
+static int
+testNBDStorageCopyShares(const void *opaque)
+{
+    const qemuMigrationSharesData *data = opaque;
+    unsigned long long shares[MAX_MIRRORS] = { 0 };
+    unsigned long long total = 0;
+    size_t i;
+
+    qemuMigrationSrcNBDStorageCopyShares(data->speed, data->remaining,
+                                         shares, data->nmirrors);
+
+    for (i = 0; i < data->nmirrors; i++) {
+        if (shares[i] != data->expected[i]) {
+            VIR_TEST_VERBOSE("mirror %zu: expected %llu B/s, got %llu B/s",
+                             i, data->expected[i], shares[i]);
+            return -1;
+        }
+
+        if (shares[i] == 0) {
+            VIR_TEST_VERBOSE("mirror %zu is unlimited", i);
+            return -1;
+        }
+
+        total += shares[i];
+    }
+
+    /* the limit can only be exceeded by the 1 B/s minimum */
+    if (total > data->speed && data->speed >= data->nmirrors) {
+        VIR_TEST_VERBOSE("%llu B/s exceed the limit of %llu B/s",
+                         total, data->speed);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+typedef struct _qemuMigrationSwitchoverData qemuMigrationSwitchoverData;
+struct _qemuMigrationSwitchoverData {
+    unsigned int ratio;
+    unsigned int throttle;
+    unsigned long flags;
+    unsigned long long iteration;
+    unsigned long long bps;
+    unsigned long long dirtyPages;
+    bool stuck;
+    virDomainJobAutoSwitchover action;
+};
+
+
+static int
+testAutoSwitchoverPolicy(const void *opaque)
+{
+    const qemuMigrationSwitchoverData *data = opaque;
+    g_autoptr(virQEMUDriverConfig) cfg = NULL;
+    qemuMonitorMigrationStats stats = {
+        .ram_iteration = data->iteration,
+        .ram_bps = data->bps,
+        .ram_dirty_rate = data->dirtyPages,
+        .ram_page_size = 4096,
+    };
+    virDomainJobAutoSwitchover action;
+    bool stuck;
+
+    if (!(cfg = virQEMUDriverConfigNew(false)))
+        return -1;
+
+    cfg->migrationAutoSwitchoverRatio = data->ratio;
+    cfg->migrationAutoSwitchoverIterations = 2;
+    cfg->migrationAutoSwitchoverThrottle = data->throttle;
+
+    stuck = qemuMigrationSrcAutoSwitchoverPolicy(cfg, &stats, data->flags,
+                                                 &action);
+
+    if (stuck != data->stuck || action != data->action) {
+        VIR_TEST_VERBOSE("expected %s/%d, got %s/%d",
+                         data->stuck ? "stuck" : "converging", data->action,
+                         stuck ? "stuck" : "converging", action);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/* The parameters set by the throttle action of the policy */
+static int
+testAutoSwitchoverThrottleParams(const void *opaque G_GNUC_UNUSED)
+{
+    g_autoptr(qemuMigrationParams) migParams = NULL;
+    g_autoptr(virJSONValue) json = NULL;
+    g_autofree char *actual = NULL;
+    const char *expected = "{\"cpu-throttle-increment\":50}";
+
+    if (!(migParams = qemuMigrationParamsNew()) ||
+        qemuMigrationParamsSetInt(migParams,
+                                  QEMU_MIGRATION_PARAM_THROTTLE_INCREMENT,
+                                  50) < 0)
+        return -1;
+
+    if (!(json = qemuMigrationParamsToJSON(migParams)) ||
+        !(actual = virJSONValueToString(json, false)))
+        return -1;
+
+    if (STRNEQ(actual, expected)) {
+        virTestDifference(stderr, expected, actual);
+        return -1;
+    }
+
+    /* the throttle increment is an integer, setting it as anything else
+     * is refused */
+    if (qemuMigrationParamsSetULL(migParams,
+                                  QEMU_MIGRATION_PARAM_THROTTLE_INCREMENT,
+                                  50) == 0)
+        return -1;
+    virResetLastError();
+
+    return 0;
+}
+
+
+static int
+mymain(void)
+{
+    int ret = 0;
+
+#define DO_TEST(name, spd, n, ...) \
+    do { \
+        qemuMigrationSharesData data = { \
+            .speed = spd, .nmirrors = n, __VA_ARGS__ \
+        }; \
+        if (virTestRun("nbd-shares-" name, \
+                       testNBDStorageCopyShares, &data) < 0) \
+            ret = -1; \
+    } while (0)
+
+    /* copying mirrors share the bandwidth by the data left to copy */
+    DO_TEST("copying", 1000, 2,
+            .remaining = { 100, 300 },
+            .expected = { 250, 750 });
+
+    /* ready mirrors get a small share only, nothing is left over for
+     * them to keep */
+    DO_TEST("one-ready", 1000, 2,
+            .remaining = { 0, 500 },
+            .expected = { 25, 975 });
+    DO_TEST("two-ready", 4000, 4,
+            .remaining = { 0, 1, 0, 3 },
+            .expected = { 50, 975, 50, 2925 });
+
+    /* once all are ready they share the bandwidth evenly */
+    DO_TEST("all-ready", 1000, 3,
+            .remaining = { 0, 0, 0 },
+            .expected = { 333, 333, 333 });
+
+    /* no mirror is ever left unlimited */
+    DO_TEST("tiny", 10, 2,
+            .remaining = { 0, 50 },
+            .expected = { 1, 10 });
+
+    DO_TEST("large", 1ULL << 40, 3,
+            .remaining = { 1ULL << 50, 0, 1ULL << 50 },
+            .expected = { 540593216990ULL, 18325193796ULL, 540593216990ULL });
+
+#undef DO_TEST
+
+#define DO_TEST(name, ...) \
+    do { \
+        qemuMigrationSwitchoverData data = { \
+            .ratio = 80, .throttle = 50, .iteration = 2, .bps = 100 << 20, \
+            __VA_ARGS__ \
+        }; \
+        if (virTestRun("auto-switchover-" name, \
+                       testAutoSwitchoverPolicy, &data) < 0) \
+            ret = -1; \
+    } while (0)
+
+    /* 80 MiB/s of the 100 MiB/s bandwidth are redirtied at once */
+    DO_TEST("postcopy",
+            .flags = VIR_MIGRATE_POSTCOPY | VIR_MIGRATE_AUTO_CONVERGE,
+            .dirtyPages = 20480,
+            .stuck = true, .action = VIR_DOMAIN_JOB_AUTO_SWITCHOVER_POSTCOPY);
+    DO_TEST("throttle",
+            .flags = VIR_MIGRATE_AUTO_CONVERGE,
+            .dirtyPages = 20480,
+            .stuck = true, .action = VIR_DOMAIN_JOB_AUTO_SWITCHOVER_THROTTLE);
+
+    /* the migration is stuck, but there's nothing to be done about it */
+    DO_TEST("no-action",
+            .dirtyPages = 20480,
+            .stuck = true);
+    DO_TEST("no-throttle",
+            .throttle = 0, .flags = VIR_MIGRATE_AUTO_CONVERGE,
+            .dirtyPages = 20480,
+            .stuck = true);
+
+    /* the policy only acts on migrations which don't converge */
+    DO_TEST("converging",
+            .flags = VIR_MIGRATE_POSTCOPY,
+            .dirtyPages = 20479);
+    DO_TEST("first-iteration",
+            .iteration = 1, .flags = VIR_MIGRATE_POSTCOPY,
+            .dirtyPages = 20480);
+    DO_TEST("no-bandwidth",
+            .bps = 0, .flags = VIR_MIGRATE_POSTCOPY,
+            .dirtyPages = 20480);
+    DO_TEST("disabled",
+            .ratio = 0, .flags = VIR_MIGRATE_POSTCOPY,
+            .dirtyPages = 20480);
+
+#undef DO_TEST
+
+    if (virTestRun("auto-switchover-throttle-params",
+                   testAutoSwitchoverThrottleParams, NULL) < 0)
+        ret = -1;
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN(mymain)
@@ -0,0 +1,218 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "testutils.h"
+#include "virfile.h"
+#include "virstring.h"
+
+#define LIBVIRT_VIRCOMMANDPRIV_H_ALLOW
+#include "vircommandpriv.h"
+#define LIBVIRT_STORAGE_BACKEND_LOGICAL_PRIV_H_ALLOW
+#include "storage/storage_backend_logical_priv.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+/* lvs --separator # --noheadings --units b --unbuffered --nosuffix
+ *     --options lv_name,origin,uuid,devices,segtype,stripes,seg_size,\
+ *               vg_extent_size,size,lv_attr,vg_size,vg_free vg0 */
+static const char *lvsOutput =
+    "  root##06UgP5-2rhb-w3Bo-3mdR-WeoL-pytO-SAa2ky#/dev/sda2(0)#linear#1#"
+    "5234491392#4194304#5234491392#-wi-ao----#10603200512#4328521728\n"
+    "  stripes##fSLSZH-zAS2-yAIb-n4mV-Al9u-HA3V-oo9K1B#"
+    "/dev/sdc1(10240),/dev/sdd1(0)#striped#2#1073741824#4194304#"
+    "1073741824#-wi-a-----#10603200512#4328521728#\n"
+    "  inactive##UB5hFw-kmlm-LSoX-EI1t-ioVd-h7GL-M0W8Ht#/dev/sda2(1248)#"
+    "linear#1#1040187392#4194304#1040187392#-wi-------#"
+    "10603200512#4328521728\n"
+    "  thinpool##3pg3he-mQsA-5Sui-h0i6-HNmc-Cz7W-QSndcR#thinpool_tdata(0)#"
+    "thin-pool#1#213909504#4194304#213909504#twi-a-tz--#"
+    "10603200512#4328521728\n";
+
+/* vgs --separator : --noheadings --units b --unbuffered --nosuffix
+ *     --options vg_size,vg_free vg0 */
+static const char *vgsOutput =
+    "  10603200512:4328521728\n";
+
+struct testRefreshPoolData {
+    const char *scratchdir;
+    const char *lvs; /* output of lvs */
+    size_t nvols;
+    bool vgs; /* whether vgs has to be run */
+};
+
+struct testRefreshPoolCbData {
+    const char *lvs;
+    bool vgsRun;
+};
+
+
+static void
+testLVMCb(const char *const*args,
+          const char *const*env G_GNUC_UNUSED,
+          const char *input G_GNUC_UNUSED,
+          char **output,
+          char **error G_GNUC_UNUSED,
+          int *status,
+          void *opaque)
+{
+    struct testRefreshPoolCbData *data = opaque;
+
+    if (STREQ(args[0], LVS)) {
+        *output = g_strdup(data->lvs);
+    } else if (STREQ(args[0], VGS)) {
+        *output = g_strdup(vgsOutput);
+        data->vgsRun = true;
+    } else if (!strstr(args[0], "udevadm")) {
+        fprintf(stderr, "unexpected command '%s'\n", args[0]);
+        *status = EXIT_FAILURE;
+    }
+}
+
+
+static int
+testCheckVol(virStoragePoolObjPtr pool,
+             const char *name,
+             unsigned long long allocation,
+             size_t nextents)
+{
+    virStorageVolDefPtr vol;
+
+    if (!(vol = virStorageVolDefFindByName(pool, name))) {
+        fprintf(stderr, "volume '%s' is missing\n", name);
+        return -1;
+    }
+
+    if (vol->target.allocation != allocation ||
+        vol->source.nextent != nextents) {
+        fprintf(stderr, "volume '%s' has allocation %llu and %zu extents\n",
+                name, vol->target.allocation, vol->source.nextent);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/* Refresh a logical pool from canned LVM output and check that the size
+ * of the volume group is taken from the LV report, with vgs run only when
+ * the group has no LVs. */
+static int
+testRefreshPool(const void *opaque)
+{
+    const struct testRefreshPoolData *data = opaque;
+    struct testRefreshPoolCbData cbdata = { .lvs = data->lvs };
+    g_autoptr(virStoragePoolDef) def = NULL;
+    g_autofree char *xml = NULL;
+    virStoragePoolObjPtr pool = NULL;
+    virStoragePoolDefPtr pooldef;
+    const char *lvnames[] = { "root", "stripes", "inactive", "thinpool" };
+    size_t i;
+    int ret = -1;
+
+    /* The LV device nodes are stood in for by regular files */
+    for (i = 0; i < G_N_ELEMENTS(lvnames); i++) {
+        g_autofree char *path = g_strdup_printf("%s/%s", data->scratchdir,
+                                                lvnames[i]);
+
+        if (virFileTouch(path, 0600) < 0)
+            return -1;
+    }
+
+    xml = g_strdup_printf("<pool type='logical'><name>vg0</name>"
+                          "<source><name>vg0</name></source>"
+                          "<target><path>%s</path></target></pool>",
+                          data->scratchdir);
+
+    if (!(def = virStoragePoolDefParseString(xml)) ||
+        !(pool = virStoragePoolObjNew()))
+        return -1;
+
+    virStoragePoolObjSetDef(pool, g_steal_pointer(&def));
+    pooldef = virStoragePoolObjGetDef(pool);
+
+    virCommandSetDryRun(NULL, testLVMCb, &cbdata);
+
+    if (virStorageBackendLogicalRefreshPool(pool) < 0)
+        goto cleanup;
+
+    if (pooldef->capacity != 10603200512ULL ||
+        pooldef->available != 4328521728ULL ||
+        pooldef->allocation != 10603200512ULL - 4328521728ULL) {
+        fprintf(stderr, "unexpected pool size %llu/%llu/%llu\n",
+                pooldef->capacity, pooldef->allocation, pooldef->available);
+        goto cleanup;
+    }
+
+    if (cbdata.vgsRun != data->vgs) {
+        fprintf(stderr, "vgs %s\n", cbdata.vgsRun ? "run" : "not run");
+        goto cleanup;
+    }
+
+    if (virStoragePoolObjGetVolumesCount(pool) != data->nvols)
+        goto cleanup;
+
+    if (data->nvols &&
+        (testCheckVol(pool, "root", 5234491392ULL, 1) < 0 ||
+         testCheckVol(pool, "stripes", 1073741824ULL, 2) < 0))
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    virCommandSetDryRun(NULL, NULL, NULL);
+    virStoragePoolObjEndAPI(&pool);
+    return ret;
+}
+
+
+#define SCRATCHDIRTEMPLATE abs_builddir "/storagebackendlogicaldir-XXXXXX"
+
+static int
+mymain(void)
+{
+    char scratchdir[] = SCRATCHDIRTEMPLATE;
+    int ret = 0;
+
+    if (!g_mkdtemp(scratchdir)) {
+        fprintf(stderr, "Cannot create storagebackendlogicaldir");
+        return EXIT_FAILURE;
+    }
+
+#define DO_TEST_REFRESH_POOL(name, output, count, runvgs) \
+    do { \
+        struct testRefreshPoolData data = { \
+            .scratchdir = scratchdir, .lvs = output, \
+            .nvols = count, .vgs = runvgs, \
+        }; \
+        if (virTestRun("refresh-pool-" name, testRefreshPool, &data) < 0) \
+            ret = -1; \
+    } while (0)
+
+    /* inactive LVs and thin pools are not volumes */
+    DO_TEST_REFRESH_POOL("lvs", lvsOutput, 2, false);
+    DO_TEST_REFRESH_POOL("empty", "", 0, true);
+
+#undef DO_TEST_REFRESH_POOL
+
+    if (getenv("LIBVIRT_SKIP_CLEANUP") == NULL)
+        virFileDeleteTree(scratchdir);
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN(mymain)
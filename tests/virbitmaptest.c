@@ -771,6 +771,30 @@ test15(const void *opaque)
 }
 
 
+/* virBitmapFormat() of ranges crossing word boundaries */
+static int
+test16(const void *opaque)
+{
+    const char *expect = opaque;
+    g_autoptr(virBitmap) map = NULL;
+    g_autofree char *str = NULL;
+
+    if (virBitmapParse(expect, &map, 512) < 0)
+        return -1;
+
+    if (!(str = virBitmapFormat(map)))
+        return -1;
+
+    if (STRNEQ(str, expect)) {
+        fprintf(stderr, "\n expected bitmap string '%s' actual string "
+                "'%s'\n", expect, str);
+        return -1;
+    }
+
+    return 0;
+}
+
+
 #define TESTBINARYOP(A, B, RES, FUNC) \
     testBinaryOpData.a = A; \
     testBinaryOpData.b = B; \
@@ -838,6 +862,18 @@ mymain(void)
     TESTBINARYOP("12345", "0,^0", "12345", test15);
     TESTBINARYOP("0,^0", "0,^0", "0,^0", test15);
 
+    virTestCounterReset("test16-");
+#define TEST_FORMAT(str) \
+    if (virTestRun(virTestCounterNext(), test16, str) < 0) \
+        ret = -1;
+
+    TEST_FORMAT("0-511");
+    TEST_FORMAT("511");
+    TEST_FORMAT("63-64");
+    TEST_FORMAT("0,63-127,129,510-511");
+    TEST_FORMAT("1-62,65-126,128-447");
+#undef TEST_FORMAT
+
     return ret;
 }
 
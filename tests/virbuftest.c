@@ -309,6 +309,40 @@ testBufEscapeStr(const void *opaque G_GNUC_UNUSED)
 }
 
 
+struct testBufEscapeStrFormatData {
+    const char *format;
+    const char *data;
+    const char *expect;
+};
+
+static int
+testBufEscapeStrFormat(const void *opaque)
+{
+    const struct testBufEscapeStrFormatData *data = opaque;
+    virBuffer buf = VIR_BUFFER_INITIALIZER;
+    g_autofree char *actual = NULL;
+
+    virBufferAddLit(&buf, "<c>\n");
+    virBufferAdjustIndent(&buf, 2);
+    virBufferEscapeString(&buf, data->format, data->data);
+    virBufferAdjustIndent(&buf, -2);
+    virBufferAddLit(&buf, "</c>");
+
+    if (!(actual = virBufferContentAndReset(&buf))) {
+        VIR_TEST_DEBUG("buf is empty");
+        return -1;
+    }
+
+    if (STRNEQ_NULLABLE(actual, data->expect)) {
+        VIR_TEST_DEBUG("testBufEscapeStrFormat(): Strings don't match:");
+        virTestDifference(stderr, data->expect, actual);
+        return -1;
+    }
+
+    return 0;
+}
+
+
 static int
 testBufEscapeRegex(const void *opaque)
 {
@@ -423,6 +457,24 @@ mymain(void)
     DO_TEST_ESCAPE("\x01\x01\x02\x03\x05\x08",
                    "<c>\n  <el></el>\n</c>");
 
+#define DO_TEST_ESCAPE_FORMAT(format, data, expect) \
+    do { \
+        struct testBufEscapeStrFormatData info = { format, data, expect }; \
+        if (virTestRun("Buf: EscapeStr format", testBufEscapeStrFormat, &info) < 0) \
+            ret = -1; \
+    } while (0)
+
+    DO_TEST_ESCAPE_FORMAT("%s", "a<b", "<c>\n  a&lt;b</c>");
+    DO_TEST_ESCAPE_FORMAT("%s\n", "plain", "<c>\n  plain\n</c>");
+    DO_TEST_ESCAPE_FORMAT("<name>%s</name>\n", "x'y\x01",
+                          "<c>\n  <name>x&apos;y</name>\n</c>");
+    DO_TEST_ESCAPE_FORMAT("<path a='%s'/>\n", "",
+                          "<c>\n  <path a=''/>\n</c>");
+    DO_TEST_ESCAPE_FORMAT("<rate>100%%</rate><v>%s</v>\n", "&",
+                          "<c>\n  <rate>100%</rate><v>&amp;</v>\n</c>");
+    DO_TEST_ESCAPE_FORMAT("<v>%s</v><rate>%%</rate>\n", ">",
+                          "<c>\n  <v>&gt;</v><rate>%</rate>\n</c>");
+
 #define DO_TEST_ESCAPE_REGEX(data, expect) \
     do { \
         struct testBufAddStrData info = { data, expect }; \
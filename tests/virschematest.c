@@ -23,6 +23,7 @@
 
 #include "virerror.h"
 #include "viralloc.h"
+#include "virfile.h"
 #include "virlog.h"
 #include "virxml.h"
 
@@ -145,6 +146,94 @@ testSchemaGrammar(const void *opaque)
 }
 
 
+#define SCHEMACACHEDIRTEMPLATE abs_builddir "/virschemacache-XXXXXX"
+
+static const char testSchemaCacheMain[] =
+    "<grammar xmlns='http://relaxng.org/ns/structure/1.0'>\n"
+    "  <include href='included.rng'/>\n"
+    "  <start><element name='doc'><ref name='content'/></element></start>\n"
+    "</grammar>\n";
+
+#define TEST_SCHEMA_CACHE_INCLUDED(element) \
+    "<grammar xmlns='http://relaxng.org/ns/structure/1.0'>\n" \
+    "  <define name='content'><element name='" element "'>" \
+    "<empty/></element></define>\n" \
+    "</grammar>\n"
+
+
+static int
+testSchemaCacheValidate(const char *schema,
+                        const char *xmlStr,
+                        bool valid)
+{
+    xmlDocPtr xml;
+    int rc;
+
+    if (!(xml = virXMLParseString(xmlStr, NULL)))
+        return -1;
+
+    rc = virXMLValidateAgainstSchema(schema, xml);
+    xmlFreeDoc(xml);
+
+    if ((rc == 0) != valid) {
+        fprintf(stderr, "'%s' unexpectedly %s validation\n",
+                xmlStr, valid ? "failed" : "passed");
+        return -1;
+    }
+
+    if (!valid && virGetLastErrorCode() != VIR_ERR_XML_INVALID_SCHEMA) {
+        fprintf(stderr, "unexpected error: %s\n", virGetLastErrorMessage());
+        return -1;
+    }
+
+    virResetLastError();
+    return 0;
+}
+
+
+/* Validating against the same schema again uses the compiled schema,
+ * which must not outlive a change to the files it includes. */
+static int
+testSchemaCache(const void *opaque G_GNUC_UNUSED)
+{
+    char dir[] = SCHEMACACHEDIRTEMPLATE;
+    g_autofree char *schema = NULL;
+    g_autofree char *included = NULL;
+    int ret = -1;
+
+    if (!g_mkdtemp(dir)) {
+        fprintf(stderr, "cannot create schema directory\n");
+        return -1;
+    }
+
+    schema = g_strdup_printf("%s/main.rng", dir);
+    included = g_strdup_printf("%s/included.rng", dir);
+
+    if (virFileWriteStr(schema, testSchemaCacheMain, 0644) < 0 ||
+        virFileWriteStr(included, TEST_SCHEMA_CACHE_INCLUDED("a"), 0644) < 0)
+        goto cleanup;
+
+    if (testSchemaCacheValidate(schema, "<doc><a/></doc>", true) < 0 ||
+        testSchemaCacheValidate(schema, "<doc><bb/></doc>", false) < 0 ||
+        testSchemaCacheValidate(schema, "<doc><a/></doc>", true) < 0)
+        goto cleanup;
+
+    /* Only the included file changes */
+    if (virFileWriteStr(included, TEST_SCHEMA_CACHE_INCLUDED("bb"), 0644) < 0)
+        goto cleanup;
+
+    if (testSchemaCacheValidate(schema, "<doc><bb/></doc>", true) < 0 ||
+        testSchemaCacheValidate(schema, "<doc><a/></doc>", false) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    virFileDeleteTree(dir);
+    return ret;
+}
+
+
 static int
 mymain(void)
 {
@@ -227,6 +316,9 @@ mymain(void)
 
     DO_TEST_FILE("../news.rng", "../docs/news.xml");
 
+    if (virTestRun("schema cache", testSchemaCache, NULL) < 0)
+        ret = -1;
+
     return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
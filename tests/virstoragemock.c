@@ -0,0 +1,92 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "internal.h"
+#include "virfile.h"
+#include "virmock.h"
+
+static int (*real_open)(const char *path, int flags, ...);
+static gint64 (*real_g_get_real_time)(void);
+
+static void
+init_syms(void)
+{
+    if (real_open)
+        return;
+
+    VIR_MOCK_REAL_INIT(open);
+    VIR_MOCK_REAL_INIT(g_get_real_time);
+}
+
+
+/* With VIR_STORAGE_MOCK_SETTLED set all files look like they were last
+ * modified long ago, so that their headers get cached. */
+gint64
+g_get_real_time(void)
+{
+    init_syms();
+
+    if (getenv("VIR_STORAGE_MOCK_SETTLED"))
+        return real_g_get_real_time() + 3600 * G_USEC_PER_SEC;
+
+    return real_g_get_real_time();
+}
+
+
+/* Opening the file named by VIR_STORAGE_MOCK_DENY_OPEN fails, which tells
+ * apart headers served from the cache from headers read from the file. */
+int
+open(const char *path, int flags, ...)
+{
+    const char *deny = getenv("VIR_STORAGE_MOCK_DENY_OPEN");
+    mode_t mode = 0;
+    va_list ap;
+
+    init_syms();
+
+    if (deny && STREQ(path, deny)) {
+        errno = EACCES;
+        return -1;
+    }
+
+    /* The mode argument is mandatory when O_CREAT is set in flags,
+     * otherwise the argument is ignored.
+     */
+    if (flags & O_CREAT) {
+        va_start(ap, flags);
+        mode = (mode_t) va_arg(ap, int);
+        va_end(ap);
+    }
+
+    return real_open(path, flags, mode);
+}
+
+
+/* Checking access as another user needs root, the header cache doesn't
+ * care who the checks are done as. */
+int
+virFileAccessibleAs(const char *path,
+                    int mode,
+                    uid_t uid G_GNUC_UNUSED,
+                    gid_t gid G_GNUC_UNUSED)
+{
+    return access(path, mode);
+}
@@ -630,6 +630,84 @@ testBackingParse(const void *args)
 }
 
 
+static int
+testHeaderCacheWalk(const char *path,
+                    const char *deny,
+                    uid_t uid, gid_t gid,
+                    bool expectSuccess)
+{
+    g_autoptr(virStorageSource) src = NULL;
+
+    if (deny)
+        g_setenv("VIR_STORAGE_MOCK_DENY_OPEN", deny, TRUE);
+    else
+        g_unsetenv("VIR_STORAGE_MOCK_DENY_OPEN");
+
+    src = testStorageFileGetMetadata(path, VIR_STORAGE_FILE_RAW, uid, gid);
+    g_unsetenv("VIR_STORAGE_MOCK_DENY_OPEN");
+
+    if (!!src != expectSuccess) {
+        fprintf(stderr, "reading header of '%s' as %d:%d (denied: %s) "
+                "unexpectedly %s\n", path, (int) uid, (int) gid,
+                NULLSTR(deny), src ? "succeeded" : "failed");
+        return -1;
+    }
+
+    virResetLastError();
+    return 0;
+}
+
+
+static int
+testHeaderCache(const void *args G_GNUC_UNUSED)
+{
+    g_autofree char *cached = g_strdup_printf("%s/cached", datadir);
+    g_autofree char *empty = g_strdup_printf("%s/empty", datadir);
+    uid_t uid = geteuid();
+    gid_t gid = getegid();
+    int ret = -1;
+
+    g_setenv("VIR_STORAGE_MOCK_SETTLED", "1", TRUE);
+
+    if (virFileWriteStr(cached, "header", 0644) < 0 ||
+        virFileWriteStr(empty, "", 0644) < 0) {
+        fprintf(stderr, "failed to create test images\n");
+        goto cleanup;
+    }
+
+    /* Populate the cache, then make sure it's used by the same user and
+     * group no matter whether they are given explicitly */
+    if (testHeaderCacheWalk(cached, NULL, -1, -1, true) < 0 ||
+        testHeaderCacheWalk(cached, cached, -1, -1, true) < 0 ||
+        testHeaderCacheWalk(cached, cached, uid, gid, true) < 0)
+        goto cleanup;
+
+    /* A different group must not get the header read by another one */
+    if (testHeaderCacheWalk(cached, cached, uid, gid + 1, false) < 0)
+        goto cleanup;
+
+    /* A changed file is read again */
+    if (virFileWriteStr(cached, "changed header", 0644) < 0 ||
+        testHeaderCacheWalk(cached, cached, -1, -1, false) < 0 ||
+        testHeaderCacheWalk(cached, NULL, -1, -1, true) < 0 ||
+        testHeaderCacheWalk(cached, cached, -1, -1, true) < 0)
+        goto cleanup;
+
+    /* Empty headers are never cached */
+    if (testHeaderCacheWalk(empty, NULL, -1, -1, true) < 0 ||
+        testHeaderCacheWalk(empty, empty, -1, -1, false) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    g_unsetenv("VIR_STORAGE_MOCK_SETTLED");
+    unlink(cached);
+    unlink(empty);
+    return ret;
+}
+
+
 static int
 mymain(void)
 {
@@ -1118,6 +1196,9 @@ mymain(void)
     TEST_LOOKUP_TARGET(80, "vda", chain3, "vda[2]", 2, NULL, NULL, NULL);
     TEST_LOOKUP_TARGET(81, "vda", NULL, "vda[3]", 3, NULL, NULL, NULL);
 
+    if (virTestRun("Header cache", testHeaderCache, NULL) < 0)
+        ret = -1;
+
 #define TEST_PATH_CANONICALIZE(id, PATH, EXPECT) \
     do { \
         data3.path = PATH; \
@@ -1568,4 +1649,4 @@ mymain(void)
     return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
-VIR_TEST_MAIN(mymain)
+VIR_TEST_MAIN_PRELOAD(mymain, VIR_TEST_MOCK("virstorage"))
@@ -0,0 +1,84 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "internal.h"
+#include "virmock.h"
+
+#ifdef HAVE_COPY_FILE_RANGE
+static ssize_t (*real_copy_file_range)(int fd_in, off_t *off_in,
+                                       int fd_out, off_t *off_out,
+                                       size_t len, unsigned int flags);
+
+/* VIR_STORAGE_UTIL_MOCK_COPY_FILE_RANGE set to "exdev" pretends the files
+ * are on different filesystems of an older kernel, so that volumes are
+ * copied through a buffer. With "eio" copying fails. Otherwise the real
+ * function is used. */
+ssize_t
+copy_file_range(int fd_in,
+                off_t *off_in,
+                int fd_out,
+                off_t *off_out,
+                size_t len,
+                unsigned int flags)
+{
+    const char *mode = getenv("VIR_STORAGE_UTIL_MOCK_COPY_FILE_RANGE");
+
+    VIR_MOCK_REAL_INIT(copy_file_range);
+
+    if (STREQ_NULLABLE(mode, "exdev")) {
+        errno = EXDEV;
+        return -1;
+    }
+
+    if (STREQ_NULLABLE(mode, "eio")) {
+        errno = EIO;
+        return -1;
+    }
+
+    return real_copy_file_range(fd_in, off_in, fd_out, off_out, len, flags);
+}
+#endif /* HAVE_COPY_FILE_RANGE */
+
+
+#ifdef HAVE_FALLOCATE
+static int (*real_fallocate)(int fd, int mode, off_t offset, off_t len);
+
+/* VIR_STORAGE_UTIL_MOCK_FALLOCATE set to "eio" makes fallocate() fail, to
+ * make sure volumes are wiped without it. Otherwise the real function is
+ * used. */
+int
+fallocate(int fd,
+          int mode,
+          off_t offset,
+          off_t len)
+{
+    const char *mockmode = getenv("VIR_STORAGE_UTIL_MOCK_FALLOCATE");
+
+    VIR_MOCK_REAL_INIT(fallocate);
+
+    if (STREQ_NULLABLE(mockmode, "eio")) {
+        errno = EIO;
+        return -1;
+    }
+
+    return real_fallocate(fd, mode, offset, len);
+}
+#endif /* HAVE_FALLOCATE */
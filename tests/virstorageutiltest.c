@@ -16,13 +16,18 @@
 
 #include <config.h>
 
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
 
 #include "testutils.h"
+#include "stat-time.h"
 #include "virerror.h"
 #include "virfile.h"
 #include "virlog.h"
 #include "virstring.h"
 
+#include "virstorageobj.h"
 #include "storage/storage_util.h"
 
 #define VIR_FROM_THIS VIR_FROM_NONE
@@ -70,9 +75,728 @@ testGlusterExtractPoolSources(const void *opaque)
 }
 
 
+#define COPY_SIZE (1024 * 1024)
+#define COPY_DATA_OFFSET (512 * 1024)
+
+struct testVolBuildFromLocalData {
+    const char *scratchdir;
+    const char *mock; /* how the mocked copy_file_range() behaves */
+    bool sparse; /* whether the clone has zero allocation */
+};
+
+/* Clone a raw volume which starts with a hole and check both the data and
+ * the allocation of the clone. */
+static int
+testVolBuildFromLocal(const void *opaque)
+{
+    const struct testVolBuildFromLocalData *data = opaque;
+    g_autoptr(virStoragePoolDef) pooldef = NULL;
+    g_autoptr(virStorageVolDef) inputvol = NULL;
+    g_autoptr(virStorageVolDef) vol = NULL;
+    virStoragePoolObjPtr pool = NULL;
+    g_autofree char *poolxml = NULL;
+    g_autofree char *inputxml = NULL;
+    g_autofree char *volxml = NULL;
+    g_autofree char *inputpath = NULL;
+    g_autofree char *volpath = NULL;
+    g_autofree char *expected = NULL;
+    g_autofree char *actual = NULL;
+    VIR_AUTOCLOSE fd = -1;
+    off_t inputdata;
+    off_t voldata;
+    size_t i;
+    int len;
+    int ret = -1;
+
+    inputpath = g_strdup_printf("%s/input.raw", data->scratchdir);
+    volpath = g_strdup_printf("%s/clone.raw", data->scratchdir);
+
+    expected = g_new0(char, COPY_SIZE);
+    for (i = COPY_DATA_OFFSET; i < COPY_SIZE; i++)
+        expected[i] = i % 251 + 1;
+
+    if ((fd = open(inputpath, O_WRONLY | O_CREAT | O_TRUNC, 0600)) < 0 ||
+        ftruncate(fd, COPY_SIZE) < 0 ||
+        lseek(fd, COPY_DATA_OFFSET, SEEK_SET) < 0 ||
+        safewrite(fd, expected + COPY_DATA_OFFSET,
+                  COPY_SIZE - COPY_DATA_OFFSET) < 0 ||
+        (inputdata = lseek(fd, 0, SEEK_DATA)) < 0 ||
+        VIR_CLOSE(fd) < 0) {
+        fprintf(stderr, "cannot create '%s'\n", inputpath);
+        goto cleanup;
+    }
+
+    poolxml = g_strdup_printf("<pool type='dir'><name>copy</name>"
+                              "<target><path>%s</path></target></pool>",
+                              data->scratchdir);
+    inputxml = g_strdup_printf("<volume><name>input.raw</name>"
+                               "<capacity>%d</capacity>"
+                               "<target><path>%s</path>"
+                               "<format type='raw'/></target></volume>",
+                               COPY_SIZE, inputpath);
+    volxml = g_strdup_printf("<volume><name>clone.raw</name>"
+                             "<capacity>%d</capacity>"
+                             "<allocation>%d</allocation>"
+                             "<target><path>%s</path>"
+                             "<format type='raw'/></target></volume>",
+                             COPY_SIZE, data->sparse ? 0 : COPY_SIZE,
+                             volpath);
+
+    if (!(pooldef = virStoragePoolDefParseString(poolxml)) ||
+        !(inputvol = virStorageVolDefParseString(pooldef, inputxml, 0)) ||
+        !(vol = virStorageVolDefParseString(pooldef, volxml, 0)))
+        goto cleanup;
+
+    if (!(pool = virStoragePoolObjNew()))
+        goto cleanup;
+    virStoragePoolObjSetDef(pool, g_steal_pointer(&pooldef));
+
+    if (data->mock)
+        g_setenv("VIR_STORAGE_UTIL_MOCK_COPY_FILE_RANGE", data->mock, TRUE);
+    else
+        g_unsetenv("VIR_STORAGE_UTIL_MOCK_COPY_FILE_RANGE");
+
+    if (virStorageBackendVolBuildFromLocal(pool, vol, inputvol, 0) < 0)
+        goto cleanup;
+
+    if ((len = virFileReadAll(volpath, COPY_SIZE + 1, &actual)) < 0)
+        goto cleanup;
+
+    if (len != COPY_SIZE || memcmp(actual, expected, COPY_SIZE) != 0) {
+        fprintf(stderr, "contents of '%s' differ from '%s'\n",
+                volpath, inputpath);
+        goto cleanup;
+    }
+
+    /* Only check the holes if the filesystem keeps them */
+    if (inputdata == COPY_DATA_OFFSET) {
+        if ((fd = open(volpath, O_RDONLY)) < 0 ||
+            (voldata = lseek(fd, 0, SEEK_DATA)) < 0) {
+            fprintf(stderr, "cannot look for data in '%s'\n", volpath);
+            goto cleanup;
+        }
+
+        if (data->sparse && voldata != COPY_DATA_OFFSET) {
+            fprintf(stderr, "hole of '%s' not kept in '%s'\n",
+                    inputpath, volpath);
+            goto cleanup;
+        }
+
+        if (!data->sparse && voldata != 0) {
+            fprintf(stderr, "'%s' is not fully allocated\n", volpath);
+            goto cleanup;
+        }
+    }
+
+    ret = 0;
+
+ cleanup:
+    g_unsetenv("VIR_STORAGE_UTIL_MOCK_COPY_FILE_RANGE");
+    virStoragePoolObjEndAPI(&pool);
+    unlink(inputpath);
+    unlink(volpath);
+    return ret;
+}
+
+
+static int
+testVolCacheWriteFile(const char *dir,
+                      const char *name,
+                      size_t size)
+{
+    g_autofree char *path = g_strdup_printf("%s/%s", dir, name);
+    g_autofree char *buf = g_new0(char, size + 1);
+
+    memset(buf, 'x', size);
+    if (virFileWriteStr(path, buf, 0600) < 0) {
+        fprintf(stderr, "cannot write '%s'\n", path);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static virStoragePoolObjPtr
+testVolCachePool(const char *path)
+{
+    g_autoptr(virStoragePoolDef) def = NULL;
+    g_autofree char *xml = NULL;
+    virStoragePoolObjPtr pool;
+
+    xml = g_strdup_printf("<pool type='dir'><name>cache</name>"
+                          "<target><path>%s</path></target></pool>",
+                          path);
+
+    if (!(def = virStoragePoolDefParseString(xml)) ||
+        !(pool = virStoragePoolObjNew()))
+        return NULL;
+
+    virStoragePoolObjSetDef(pool, g_steal_pointer(&def));
+    return pool;
+}
+
+
+/* Check that @name is a volume of @pool with @capacity. If @orig is given,
+ * the volume must also be identical to the one of that pool. */
+static int
+testVolCacheCheckVol(virStoragePoolObjPtr pool,
+                     virStoragePoolObjPtr orig,
+                     const char *name,
+                     unsigned long long capacity)
+{
+    virStoragePoolDefPtr def = virStoragePoolObjGetDef(pool);
+    virStorageVolDefPtr vol;
+    virStorageVolDefPtr origvol;
+    g_autofree char *xml = NULL;
+    g_autofree char *origxml = NULL;
+
+    if (!(vol = virStorageVolDefFindByName(pool, name))) {
+        fprintf(stderr, "volume '%s' is missing\n", name);
+        return -1;
+    }
+
+    if (vol->target.capacity != capacity) {
+        fprintf(stderr, "volume '%s' has capacity %llu instead of %llu\n",
+                name, vol->target.capacity, capacity);
+        return -1;
+    }
+
+    if (!orig)
+        return 0;
+
+    if (!(origvol = virStorageVolDefFindByName(orig, name)))
+        return -1;
+
+    if (memcmp(&vol->stamp, &origvol->stamp, sizeof(vol->stamp)) != 0) {
+        fprintf(stderr, "volume '%s' lost the identity of its file\n", name);
+        return -1;
+    }
+
+    if (!(xml = virStorageVolDefFormat(def, vol)) ||
+        !(origxml = virStorageVolDefFormat(def, origvol)))
+        return -1;
+
+    if (STRNEQ(xml, origxml)) {
+        virTestDifference(stderr, origxml, xml);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/* Save the volumes of a refreshed pool, load them into a new pool as on
+ * a daemon restart and refresh it after some of the files changed. */
+static int
+testVolCache(const void *opaque)
+{
+    const char *scratchdir = opaque;
+    g_autofree char *pooldir = NULL;
+    g_autofree char *otherdir = NULL;
+    g_autofree char *cachefile = NULL;
+    g_autofree char *path = NULL;
+    virStoragePoolObjPtr pool = NULL;
+    virStoragePoolObjPtr loaded = NULL;
+    virStoragePoolObjPtr other = NULL;
+    virStorageVolDefPtr vol;
+    int ret = -1;
+
+    pooldir = g_strdup_printf("%s/cachepool", scratchdir);
+    otherdir = g_strdup_printf("%s/otherpool", scratchdir);
+    cachefile = g_strdup_printf("%s/cache.vols", scratchdir);
+
+    if (g_mkdir_with_parents(pooldir, 0700) < 0 ||
+        g_mkdir_with_parents(otherdir, 0700) < 0) {
+        fprintf(stderr, "cannot create pool directories\n");
+        goto cleanup;
+    }
+
+    if (testVolCacheWriteFile(pooldir, "kept.raw", 4096) < 0 ||
+        testVolCacheWriteFile(pooldir, "changed.raw", 8192) < 0 ||
+        testVolCacheWriteFile(pooldir, "removed.raw", 4096) < 0)
+        goto cleanup;
+
+    if (!(pool = testVolCachePool(pooldir)) ||
+        virStorageBackendRefreshLocal(pool) < 0 ||
+        virStorageBackendVolCacheSave(pool, cachefile) < 0)
+        goto cleanup;
+
+    /* The loaded volumes match the probed ones */
+    if (!(loaded = testVolCachePool(pooldir)) ||
+        virStorageBackendVolCacheLoad(loaded, cachefile) < 0)
+        goto cleanup;
+
+    if (virStoragePoolObjGetVolumesCount(loaded) != 3 ||
+        testVolCacheCheckVol(loaded, pool, "kept.raw", 4096) < 0 ||
+        testVolCacheCheckVol(loaded, pool, "changed.raw", 8192) < 0 ||
+        testVolCacheCheckVol(loaded, pool, "removed.raw", 4096) < 0)
+        goto cleanup;
+
+    /* A cache of a different target path is ignored */
+    if (!(other = testVolCachePool(otherdir)) ||
+        virStorageBackendVolCacheLoad(other, cachefile) < 0)
+        goto cleanup;
+
+    if (virStoragePoolObjGetVolumesCount(other) != 0) {
+        fprintf(stderr, "cache of '%s' loaded for '%s'\n", pooldir, otherdir);
+        goto cleanup;
+    }
+
+    /* Refreshing drops or probes again the stale entries only. A changed
+     * capacity of the entry of the unchanged file shows it wasn't probed. */
+    if (!(vol = virStorageVolDefFindByName(loaded, "kept.raw")))
+        goto cleanup;
+    vol->target.capacity = 1;
+
+    path = g_strdup_printf("%s/removed.raw", pooldir);
+    if (unlink(path) < 0 ||
+        testVolCacheWriteFile(pooldir, "changed.raw", 16384) < 0 ||
+        testVolCacheWriteFile(pooldir, "added.raw", 4096) < 0)
+        goto cleanup;
+
+    if (virStorageBackendRefreshLocal(loaded) < 0)
+        goto cleanup;
+
+    if (virStoragePoolObjGetVolumesCount(loaded) != 3 ||
+        testVolCacheCheckVol(loaded, NULL, "kept.raw", 1) < 0 ||
+        testVolCacheCheckVol(loaded, NULL, "changed.raw", 16384) < 0 ||
+        testVolCacheCheckVol(loaded, NULL, "added.raw", 4096) < 0)
+        goto cleanup;
+
+    if (virStorageVolDefFindByName(loaded, "removed.raw")) {
+        fprintf(stderr, "volume of removed file is still cached\n");
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virStoragePoolObjEndAPI(&pool);
+    virStoragePoolObjEndAPI(&loaded);
+    virStoragePoolObjEndAPI(&other);
+    virFileDeleteTree(pooldir);
+    virFileDeleteTree(otherdir);
+    unlink(cachefile);
+    return ret;
+}
+
+
+/* Mark the volume of @name in @pool as not probed since, by changing its
+ * capacity to one byte, which no probe would ever report. */
+static int
+testVolRefreshMark(virStoragePoolObjPtr pool,
+                   const char *name)
+{
+    virStorageVolDefPtr vol;
+
+    if (!(vol = virStorageVolDefFindByName(pool, name))) {
+        fprintf(stderr, "volume '%s' is missing\n", name);
+        return -1;
+    }
+
+    vol->target.capacity = 1;
+    return 0;
+}
+
+
+/* Change the ctime of @path, and nothing else, by flipping its mode until
+ * the clock of the file system moves forward. */
+static int
+testVolRefreshTouchCtime(const char *path)
+{
+    struct stat orig;
+    struct stat sb;
+    size_t i;
+
+    if (stat(path, &orig) < 0)
+        return -1;
+
+    for (i = 0; i < 200; i++) {
+        if (chmod(path, (i % 2) ? 0600 : 0640) < 0 ||
+            stat(path, &sb) < 0)
+            return -1;
+
+        if (sb.st_ctime != orig.st_ctime ||
+            get_stat_ctime_ns(&sb) != get_stat_ctime_ns(&orig))
+            return 0;
+
+        g_usleep(10 * 1000);
+    }
+
+    fprintf(stderr, "ctime of '%s' doesn't change\n", path);
+    return -1;
+}
+
+
+/* Refreshing a pool probes again exactly the files whose device, inode,
+ * size, mtime or ctime differ from when their volume was probed. */
+static int
+testVolRefresh(const void *opaque)
+{
+    const char *scratchdir = opaque;
+    g_autofree char *pooldir = NULL;
+    g_autofree char *path = NULL;
+    g_autofree char *tmppath = NULL;
+    virStoragePoolObjPtr pool = NULL;
+    struct timespec times[2] = {
+        { .tv_sec = 1000000000, .tv_nsec = 0 },
+        { .tv_sec = 1000000000, .tv_nsec = 0 },
+    };
+    struct stat sb;
+    int ret = -1;
+
+    pooldir = g_strdup_printf("%s/refreshpool", scratchdir);
+    tmppath = g_strdup_printf("%s/replaced.tmp", scratchdir);
+
+    if (g_mkdir_with_parents(pooldir, 0700) < 0) {
+        fprintf(stderr, "cannot create pool directory\n");
+        goto cleanup;
+    }
+
+    if (testVolCacheWriteFile(pooldir, "kept.raw", 4096) < 0 ||
+        testVolCacheWriteFile(pooldir, "resized.raw", 4096) < 0 ||
+        testVolCacheWriteFile(pooldir, "modified.raw", 4096) < 0 ||
+        testVolCacheWriteFile(pooldir, "changed.raw", 4096) < 0 ||
+        testVolCacheWriteFile(pooldir, "replaced.raw", 4096) < 0)
+        goto cleanup;
+
+    if (!(pool = testVolCachePool(pooldir)) ||
+        virStorageBackendRefreshLocal(pool) < 0)
+        goto cleanup;
+
+    if (virStoragePoolObjGetVolumesCount(pool) != 5 ||
+        testVolRefreshMark(pool, "kept.raw") < 0 ||
+        testVolRefreshMark(pool, "resized.raw") < 0 ||
+        testVolRefreshMark(pool, "modified.raw") < 0 ||
+        testVolRefreshMark(pool, "changed.raw") < 0 ||
+        testVolRefreshMark(pool, "replaced.raw") < 0)
+        goto cleanup;
+
+    /* size */
+    if (testVolCacheWriteFile(pooldir, "resized.raw", 8192) < 0)
+        goto cleanup;
+
+    /* mtime, with the size unchanged */
+    g_free(path);
+    path = g_strdup_printf("%s/modified.raw", pooldir);
+    if (utimensat(AT_FDCWD, path, times, 0) < 0)
+        goto cleanup;
+
+    /* ctime only */
+    g_free(path);
+    path = g_strdup_printf("%s/changed.raw", pooldir);
+    if (testVolRefreshTouchCtime(path) < 0)
+        goto cleanup;
+
+    /* inode, with the size and mtime of the old file */
+    g_free(path);
+    path = g_strdup_printf("%s/replaced.raw", pooldir);
+    if (stat(path, &sb) < 0 ||
+        testVolCacheWriteFile(scratchdir, "replaced.tmp", 4096) < 0)
+        goto cleanup;
+    times[0] = get_stat_atime(&sb);
+    times[1] = get_stat_mtime(&sb);
+    if (utimensat(AT_FDCWD, tmppath, times, 0) < 0 ||
+        rename(tmppath, path) < 0)
+        goto cleanup;
+
+    if (virStorageBackendRefreshLocal(pool) < 0)
+        goto cleanup;
+
+    if (virStoragePoolObjGetVolumesCount(pool) != 5 ||
+        testVolCacheCheckVol(pool, NULL, "kept.raw", 1) < 0 ||
+        testVolCacheCheckVol(pool, NULL, "resized.raw", 8192) < 0 ||
+        testVolCacheCheckVol(pool, NULL, "modified.raw", 4096) < 0 ||
+        testVolCacheCheckVol(pool, NULL, "changed.raw", 4096) < 0 ||
+        testVolCacheCheckVol(pool, NULL, "replaced.raw", 4096) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    virStoragePoolObjEndAPI(&pool);
+    virFileDeleteTree(pooldir);
+    unlink(tmppath);
+    return ret;
+}
+
+
+/* The size of a local pool comes from the file system of its target,
+ * both when looked up on its own and on a full refresh. */
+static int
+testPoolSize(const void *opaque)
+{
+    const char *scratchdir = opaque;
+    g_autofree char *pooldir = NULL;
+    g_autofree char *missing = NULL;
+    virStoragePoolObjPtr pool = NULL;
+    virStoragePoolDefPtr def;
+    unsigned long long capacity;
+    unsigned long long allocation;
+    unsigned long long available;
+    struct statvfs sb;
+    int ret = -1;
+
+    pooldir = g_strdup_printf("%s/sizepool", scratchdir);
+    missing = g_strdup_printf("%s/missing", scratchdir);
+
+    if (g_mkdir_with_parents(pooldir, 0700) < 0 ||
+        statvfs(pooldir, &sb) < 0) {
+        fprintf(stderr, "cannot create pool directory\n");
+        goto cleanup;
+    }
+
+    if (virStorageBackendGetLocalSize(pooldir, &capacity,
+                                      &allocation, &available) < 0)
+        goto cleanup;
+
+    if (capacity != (unsigned long long)sb.f_frsize * sb.f_blocks ||
+        allocation + available != capacity) {
+        fprintf(stderr, "unexpected size %llu/%llu/%llu\n",
+                capacity, allocation, available);
+        goto cleanup;
+    }
+
+    if (!(pool = testVolCachePool(pooldir)) ||
+        virStorageBackendRefreshLocal(pool) < 0)
+        goto cleanup;
+
+    def = virStoragePoolObjGetDef(pool);
+    if (def->capacity != capacity ||
+        def->allocation + def->available != capacity) {
+        fprintf(stderr, "refresh got size %llu/%llu/%llu\n",
+                def->capacity, def->allocation, def->available);
+        goto cleanup;
+    }
+
+    /* A missing target is reported as an error */
+    if (virStorageBackendGetLocalSize(missing, &capacity,
+                                      &allocation, &available) == 0) {
+        fprintf(stderr, "size of missing directory '%s' found\n", missing);
+        goto cleanup;
+    }
+    virResetLastError();
+
+    ret = 0;
+
+ cleanup:
+    virStoragePoolObjEndAPI(&pool);
+    virFileDeleteTree(pooldir);
+    return ret;
+}
+
+
+struct testVolWipeData {
+    const char *scratchdir;
+    unsigned int algorithm;
+    const char *mock; /* how the mocked fallocate() behaves */
+};
+
+/* Wipe a fully allocated raw volume and check that it reads back as
+ * zeroes and keeps its size. */
+static int
+testVolWipe(const void *opaque)
+{
+    const struct testVolWipeData *data = opaque;
+    g_autoptr(virStorageVolDef) vol = NULL;
+    g_autofree char *path = NULL;
+    g_autofree char *expected = NULL;
+    g_autofree char *actual = NULL;
+    int len;
+    int ret = -1;
+
+    path = g_strdup_printf("%s/wipe.raw", data->scratchdir);
+
+    if (testVolCacheWriteFile(data->scratchdir, "wipe.raw", COPY_SIZE) < 0)
+        goto cleanup;
+
+    vol = g_new0(virStorageVolDef, 1);
+    vol->target.path = g_strdup(path);
+    vol->target.format = VIR_STORAGE_FILE_RAW;
+    vol->target.allocation = COPY_SIZE;
+
+    if (data->mock)
+        g_setenv("VIR_STORAGE_UTIL_MOCK_FALLOCATE", data->mock, TRUE);
+    else
+        g_unsetenv("VIR_STORAGE_UTIL_MOCK_FALLOCATE");
+
+    if (virStorageBackendVolWipeLocal(NULL, vol, data->algorithm, 0) < 0) {
+        /* not every file system can punch holes */
+        if (data->algorithm == VIR_STORAGE_VOL_WIPE_ALG_TRIM &&
+            virGetLastErrorCode() == VIR_ERR_ARGUMENT_UNSUPPORTED) {
+            virResetLastError();
+            ret = EXIT_AM_SKIP;
+        }
+        goto cleanup;
+    }
+
+    expected = g_new0(char, COPY_SIZE);
+
+    if ((len = virFileReadAll(path, COPY_SIZE + 1, &actual)) < 0)
+        goto cleanup;
+
+    if (len != COPY_SIZE || memcmp(actual, expected, COPY_SIZE) != 0) {
+        fprintf(stderr, "'%s' was not wiped\n", path);
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    g_unsetenv("VIR_STORAGE_UTIL_MOCK_FALLOCATE");
+    unlink(path);
+    return ret;
+}
+
+
+static size_t testVolHintsCalls;
+
+static bool
+testVolHintsFindKey(virStoragePoolObjPtr obj,
+                    const void *opaque)
+{
+    testVolHintsCalls++;
+
+    return !!virStorageVolDefFindByKey(obj, opaque);
+}
+
+
+static virStoragePoolObjPtr
+testVolHintsAddPool(virStoragePoolObjListPtr pools,
+                    const char *name,
+                    const char *uuid)
+{
+    g_autoptr(virStoragePoolDef) def = NULL;
+    g_autofree char *xml = NULL;
+    virStoragePoolObjPtr obj;
+
+    xml = g_strdup_printf("<pool type='dir'><name>%s</name>"
+                          "<uuid>%s</uuid>"
+                          "<target><path>/pools/%s</path></target></pool>",
+                          name, uuid, name);
+
+    if (!(def = virStoragePoolDefParseString(xml)) ||
+        !(obj = virStoragePoolObjListAdd(pools, def, 0)))
+        return NULL;
+    def = NULL;
+
+    /* lookups lock the pools themselves */
+    virObjectUnlock(obj);
+    return obj;
+}
+
+
+/* Count how many pools are searched for the key of a volume which can't
+ * be found anywhere. A hint adds one search of the hinted pool. */
+static size_t
+testVolHintsCount(virStoragePoolObjListPtr pools)
+{
+    virStoragePoolObjPtr obj;
+
+    testVolHintsCalls = 0;
+    obj = virStoragePoolObjListSearchVol(pools,
+                                         VIR_STORAGE_POOL_OBJ_VOL_HINT_KEY,
+                                         "/pools/a/vol.raw",
+                                         testVolHintsFindKey,
+                                         "/pools/missing.raw");
+    virStoragePoolObjEndAPI(&obj);
+
+    return testVolHintsCalls;
+}
+
+
+/* Volumes are looked up in the pool they were last found in first and
+ * those hints are dropped with the volumes of the pool. */
+static int
+testVolHints(const void *opaque G_GNUC_UNUSED)
+{
+    virStoragePoolObjListPtr pools = NULL;
+    virStoragePoolObjPtr a = NULL;
+    virStoragePoolObjPtr b = NULL;
+    virStoragePoolObjPtr obj = NULL;
+    virStorageVolDefPtr vol;
+    size_t calls;
+    int ret = -1;
+
+    if (!(pools = virStoragePoolObjListNew()) ||
+        !(a = testVolHintsAddPool(pools, "a",
+                                  "2a5f4a1c-0b5e-4a8c-9a34-6d1b1a6f0a01")) ||
+        !(b = testVolHintsAddPool(pools, "b",
+                                  "2a5f4a1c-0b5e-4a8c-9a34-6d1b1a6f0a02")))
+        goto cleanup;
+
+    vol = g_new0(virStorageVolDef, 1);
+    vol->name = g_strdup("vol.raw");
+    vol->key = g_strdup("/pools/a/vol.raw");
+    vol->target.path = g_strdup("/pools/a/vol.raw");
+    if (virStoragePoolObjAddVol(a, vol) < 0) {
+        virStorageVolDefFree(vol);
+        goto cleanup;
+    }
+
+    /* A remembered volume is found by searching its pool only */
+    virStoragePoolObjListRememberVol(pools, a, vol);
+    testVolHintsCalls = 0;
+    if (!(obj = virStoragePoolObjListSearchVol(pools,
+                                               VIR_STORAGE_POOL_OBJ_VOL_HINT_KEY,
+                                               vol->key,
+                                               testVolHintsFindKey,
+                                               vol->key)) ||
+        obj != a || testVolHintsCalls != 1) {
+        fprintf(stderr, "volume not found through its hint (%zu searches)\n",
+                testVolHintsCalls);
+        goto cleanup;
+    }
+    virStoragePoolObjEndAPI(&obj);
+
+    if ((calls = testVolHintsCount(pools)) != 3) {
+        fprintf(stderr, "expected 3 searches with a hint, got %zu\n", calls);
+        goto cleanup;
+    }
+
+    /* Dropping the volumes of the pool, e.g. on refresh, drops its hints */
+    virStoragePoolObjListRememberVol(pools, a, vol);
+    virStoragePoolObjListForgetPoolVols(pools, a);
+    if ((calls = testVolHintsCount(pools)) != 2) {
+        fprintf(stderr, "hint kept after dropping the volumes of the pool "
+                "(%zu searches)\n", calls);
+        goto cleanup;
+    }
+
+    /* and so does removing it, even if it's defined again */
+    virStoragePoolObjListRememberVol(pools, a, vol);
+    virObjectLock(a);
+    virStoragePoolObjRemove(pools, a);
+    virObjectUnlock(a);
+    virObjectUnref(a);
+    if (!(a = testVolHintsAddPool(pools, "a",
+                                  "2a5f4a1c-0b5e-4a8c-9a34-6d1b1a6f0a01")))
+        goto cleanup;
+
+    if ((calls = testVolHintsCount(pools)) != 2) {
+        fprintf(stderr, "hint kept after removing the pool "
+                "(%zu searches)\n", calls);
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virStoragePoolObjEndAPI(&obj);
+    virObjectUnref(a);
+    virObjectUnref(b);
+    virObjectUnref(pools);
+    return ret;
+}
+
+
+#define SCRATCHDIRTEMPLATE abs_builddir "/virstorageutildir-XXXXXX"
+
 static int
 mymain(void)
 {
+    char scratchdir[] = SCRATCHDIRTEMPLATE;
     int ret = 0;
 
 #define DO_TEST_GLUSTER_EXTRACT_POOL_SOURCES_FULL(testname, sffx, pooltype) \
@@ -104,7 +828,62 @@ mymain(void)
 #undef DO_TEST_GLUSTER_EXTRACT_POOL_SOURCES_NETFS
 #undef DO_TEST_GLUSTER_EXTRACT_POOL_SOURCES_FULL
 
+    if (!g_mkdtemp(scratchdir)) {
+        fprintf(stderr, "Cannot create virstorageutildir");
+        return EXIT_FAILURE;
+    }
+
+#define DO_TEST_VOL_BUILD_FROM_LOCAL(name, mockmode, isSparse) \
+    do { \
+        struct testVolBuildFromLocalData data = { \
+            .scratchdir = scratchdir, .mock = mockmode, .sparse = isSparse, \
+        }; \
+        if (virTestRun("vol-build-from-local-" name, \
+                       testVolBuildFromLocal, &data) < 0) \
+            ret = -1; \
+    } while (0)
+
+    /* sparse clones are copied by copy_file_range() where it's available */
+    DO_TEST_VOL_BUILD_FROM_LOCAL("copy-range", NULL, true);
+    /* EXDEV falls back to the buffered copy */
+    DO_TEST_VOL_BUILD_FROM_LOCAL("fallback", "exdev", true);
+    /* a preallocated clone never uses copy_file_range() */
+    DO_TEST_VOL_BUILD_FROM_LOCAL("allocated", "eio", false);
+
+#undef DO_TEST_VOL_BUILD_FROM_LOCAL
+
+    if (virTestRun("vol-cache", testVolCache, scratchdir) < 0)
+        ret = -1;
+
+    if (virTestRun("vol-refresh", testVolRefresh, scratchdir) < 0)
+        ret = -1;
+
+    if (virTestRun("pool-size", testPoolSize, scratchdir) < 0)
+        ret = -1;
+
+    if (virTestRun("vol-hints", testVolHints, NULL) < 0)
+        ret = -1;
+
+#define DO_TEST_VOL_WIPE(name, alg, mockmode) \
+    do { \
+        struct testVolWipeData data = { \
+            .scratchdir = scratchdir, .algorithm = alg, .mock = mockmode, \
+        }; \
+        if (virTestRun("vol-wipe-" name, testVolWipe, &data) < 0) \
+            ret = -1; \
+    } while (0)
+
+    /* files are zeroed by writing to them, never by fallocate() */
+    DO_TEST_VOL_WIPE("zero", VIR_STORAGE_VOL_WIPE_ALG_ZERO, "eio");
+    /* and trimmed by punching holes */
+    DO_TEST_VOL_WIPE("trim", VIR_STORAGE_VOL_WIPE_ALG_TRIM, NULL);
+
+#undef DO_TEST_VOL_WIPE
+
+    if (getenv("LIBVIRT_SKIP_CLEANUP") == NULL)
+        virFileDeleteTree(scratchdir);
+
     return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
-VIR_TEST_MAIN(mymain)
+VIR_TEST_MAIN_PRELOAD(mymain, VIR_TEST_MOCK("virstorageutil"))
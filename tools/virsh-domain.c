@@ -6036,6 +6036,10 @@ static const vshCmdOptDef opts_domjobinfo[] = {
      .type = VSH_OT_BOOL,
      .help = N_("print the raw data returned by libvirt")
     },
+    {.name = "telemetry",
+     .type = VSH_OT_BOOL,
+     .help = N_("print the history of progress samples")
+    },
     {.name = NULL}
 };
 
@@ -6079,6 +6083,22 @@ virshDomainJobOperationToString(int op)
 }
 
 
+VIR_ENUM_DECL(virshDomainJobAutoSwitchover);
+VIR_ENUM_IMPL(virshDomainJobAutoSwitchover,
+              VIR_DOMAIN_JOB_AUTO_SWITCHOVER_LAST,
+              N_("none"),
+              N_("post-copy"),
+              N_("throttle"),
+);
+
+static const char *
+virshDomainJobAutoSwitchoverToString(int action)
+{
+    const char *str = virshDomainJobAutoSwitchoverTypeToString(action);
+    return str ? _(str) : _("unknown");
+}
+
+
 static int
 virshDomainJobStatsToDomainJobInfo(virTypedParameterPtr params,
                                    int nparams,
@@ -6114,6 +6134,45 @@ virshDomainJobStatsToDomainJobInfo(virTypedParameterPtr params,
 }
 
 
+static int
+virshDomainJobStatsPrintTelemetry(vshControl *ctl,
+                                  virTypedParameterPtr params,
+                                  int nparams)
+{
+    const char *fields[] = { "time", "remaining", "dirty_rate",
+                             "bps", "iteration", "downtime" };
+    unsigned int count = 0;
+    size_t i;
+    size_t j;
+
+    if (virTypedParamsGetUInt(params, nparams,
+                              VIR_DOMAIN_JOB_TELEMETRY_COUNT, &count) < 0)
+        return -1;
+
+    vshPrint(ctl, "\n%-10s %-16s %-12s %-16s %-10s %-10s\n",
+             _("Time (ms)"), _("Remaining (B)"), _("Dirty rate"),
+             _("Throughput (B/s)"), _("Iteration"), _("Downtime"));
+
+    for (i = 0; i < count; i++) {
+        unsigned long long values[G_N_ELEMENTS(fields)] = { 0 };
+
+        for (j = 0; j < G_N_ELEMENTS(fields); j++) {
+            char field[VIR_TYPED_PARAM_FIELD_LENGTH];
+
+            g_snprintf(field, sizeof(field), "telemetry.%zu.%s", i, fields[j]);
+            if (virTypedParamsGetULLong(params, nparams, field, &values[j]) < 0)
+                return -1;
+        }
+
+        vshPrint(ctl, "%-10llu %-16llu %-12llu %-16llu %-10llu %-10llu\n",
+                 values[0], values[1], values[2],
+                 values[3], values[4], values[5]);
+    }
+
+    return 0;
+}
+
+
 static bool
 cmdDomjobinfo(vshControl *ctl, const vshCmd *cmd)
 {
@@ -6143,6 +6202,9 @@ cmdDomjobinfo(vshControl *ctl, const vshCmd *cmd)
     if (vshCommandOptBool(cmd, "keep-completed"))
         flags |= VIR_DOMAIN_JOB_STATS_KEEP_COMPLETED;
 
+    if (vshCommandOptBool(cmd, "telemetry"))
+        flags |= VIR_DOMAIN_JOB_STATS_TELEMETRY;
+
     memset(&info, 0, sizeof(info));
 
     rc = virDomainGetJobStats(dom, &info.type, &params, &nparams, flags);
@@ -6292,6 +6354,16 @@ cmdDomjobinfo(vshControl *ctl, const vshCmd *cmd)
         }
     }
 
+    if ((rc = virTypedParamsGetULLong(params, nparams,
+                                      VIR_DOMAIN_JOB_TUNNEL_BPS,
+                                      &value)) < 0) {
+        goto save_error;
+    } else if (rc && value) {
+        val = vshPrettyCapacity(value, &unit);
+        vshPrint(ctl, "%-17s %-.3lf %s/s\n",
+                 _("Tunnel bandwidth:"), val, unit);
+    }
+
     if ((rc = virTypedParamsGetULLong(params, nparams,
                                       VIR_DOMAIN_JOB_MEMORY_CONSTANT,
                                       &value)) < 0) {
@@ -6389,6 +6461,22 @@ cmdDomjobinfo(vshControl *ctl, const vshCmd *cmd)
         vshPrint(ctl, "%-17s %-13d\n", _("Auto converge throttle:"), ivalue);
     }
 
+    if ((rc = virTypedParamsGetInt(params, nparams,
+                                   VIR_DOMAIN_JOB_AUTO_SWITCHOVER,
+                                   &ivalue)) < 0) {
+        goto save_error;
+    } else if (rc) {
+        vshPrint(ctl, "%-17s %-13s\n", _("Auto switchover:"),
+                 virshDomainJobAutoSwitchoverToString(ivalue));
+    }
+    if ((rc = virTypedParamsGetULLong(params, nparams,
+                                      VIR_DOMAIN_JOB_AUTO_SWITCHOVER_ITERATION,
+                                      &value)) < 0) {
+        goto save_error;
+    } else if (rc) {
+        vshPrint(ctl, "%-17s %-13llu\n", _("Auto switchover iteration:"), value);
+    }
+
     if ((rc = virTypedParamsGetULLong(params, nparams,
                                       VIR_DOMAIN_JOB_DISK_TEMP_USED,
                                       &value)) < 0) {
@@ -6407,6 +6495,10 @@ cmdDomjobinfo(vshControl *ctl, const vshCmd *cmd)
         vshPrint(ctl, "%-17s %-.3lf %s\n", _("Temporary disk space total:"), val, unit);
     }
 
+    if (flags & VIR_DOMAIN_JOB_STATS_TELEMETRY &&
+        virshDomainJobStatsPrintTelemetry(ctl, params, nparams) < 0)
+        goto save_error;
+
     ret = true;
 
  cleanup: